@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#if !defined(BASE_ATOMIC_H)
+#define BASE_ATOMIC_H
+
+// NOTE(Ryan): Thin layer over gcc/clang __atomic builtins.
+// Every operation takes an explicit memory order, so each call site states what it actually needs:
+//  - RELAXED: counters and values only read for their own sake (statistics, ids)
+//  - ACQUIRE/RELEASE: publishing data through a flag, index or pointer
+//  - SEQ_CST: only for store-then-load handshakes (e.g. 'publish work, then check for sleepers'),
+//    as acquire/release doesn't prevent the later load from passing the earlier store
+// IMPORTANT(Ryan): volatile alone gives no ordering between threads, it only stops compiler elision
+
+typedef enum
+{
+  MEMORY_ORDER_RELAXED = __ATOMIC_RELAXED,
+  MEMORY_ORDER_ACQUIRE = __ATOMIC_ACQUIRE,
+  MEMORY_ORDER_RELEASE = __ATOMIC_RELEASE,
+  MEMORY_ORDER_ACQ_REL = __ATOMIC_ACQ_REL,
+  MEMORY_ORDER_SEQ_CST = __ATOMIC_SEQ_CST,
+} MEMORY_ORDER;
+
+// NOTE(Ryan): Failure order of compare exchange can't be RELEASE/ACQ_REL or stronger than success order
+#define ATOMIC_DEFINE_INTEGER(name, type) \
+  INTERNAL type \
+  atomic_##name##_load(type volatile *a, MEMORY_ORDER order) \
+  { \
+    return __atomic_load_n(a, order); \
+  } \
+  INTERNAL void \
+  atomic_##name##_store(type volatile *a, type v, MEMORY_ORDER order) \
+  { \
+    __atomic_store_n(a, v, order); \
+  } \
+  INTERNAL type \
+  atomic_##name##_load_acquire(type volatile *a) \
+  { \
+    return __atomic_load_n(a, __ATOMIC_ACQUIRE); \
+  } \
+  INTERNAL void \
+  atomic_##name##_store_release(type volatile *a, type v) \
+  { \
+    __atomic_store_n(a, v, __ATOMIC_RELEASE); \
+  } \
+  INTERNAL type \
+  atomic_##name##_fetch_add(type volatile *a, type v, MEMORY_ORDER order) \
+  { \
+    return __atomic_fetch_add(a, v, order); \
+  } \
+  INTERNAL type \
+  atomic_##name##_fetch_sub(type volatile *a, type v, MEMORY_ORDER order) \
+  { \
+    return __atomic_fetch_sub(a, v, order); \
+  } \
+  INTERNAL type \
+  atomic_##name##_exchange(type volatile *a, type v, MEMORY_ORDER order) \
+  { \
+    return __atomic_exchange_n(a, v, order); \
+  } \
+  INTERNAL b32 \
+  atomic_##name##_cas(type volatile *a, type *expected, type desired, MEMORY_ORDER success, MEMORY_ORDER failure) \
+  { \
+    return __atomic_compare_exchange_n(a, expected, desired, false, success, failure); \
+  } \
+  INTERNAL b32 \
+  atomic_##name##_cas_weak(type volatile *a, type *expected, type desired, MEMORY_ORDER success, MEMORY_ORDER failure) \
+  { \
+    return __atomic_compare_exchange_n(a, expected, desired, true, success, failure); \
+  }
+
+ATOMIC_DEFINE_INTEGER(u32, u32)
+ATOMIC_DEFINE_INTEGER(u64, u64)
+ATOMIC_DEFINE_INTEGER(s64, s64)
+
+// NOTE(Ryan): Pointer fields are passed as (void * volatile *)&field
+INTERNAL void *
+atomic_ptr_load(void * volatile *a, MEMORY_ORDER order)
+{
+  return __atomic_load_n(a, order);
+}
+
+INTERNAL void
+atomic_ptr_store(void * volatile *a, void *v, MEMORY_ORDER order)
+{
+  __atomic_store_n(a, v, order);
+}
+
+INTERNAL void *
+atomic_ptr_load_acquire(void * volatile *a)
+{
+  return __atomic_load_n(a, __ATOMIC_ACQUIRE);
+}
+
+INTERNAL void
+atomic_ptr_store_release(void * volatile *a, void *v)
+{
+  __atomic_store_n(a, v, __ATOMIC_RELEASE);
+}
+
+INTERNAL void *
+atomic_ptr_exchange(void * volatile *a, void *v, MEMORY_ORDER order)
+{
+  return __atomic_exchange_n(a, v, order);
+}
+
+INTERNAL b32
+atomic_ptr_cas(void * volatile *a, void **expected, void *desired, MEMORY_ORDER success, MEMORY_ORDER failure)
+{
+  return __atomic_compare_exchange_n(a, expected, desired, false, success, failure);
+}
+
+INTERNAL b32
+atomic_ptr_cas_weak(void * volatile *a, void **expected, void *desired, MEMORY_ORDER success, MEMORY_ORDER failure)
+{
+  return __atomic_compare_exchange_n(a, expected, desired, true, success, failure);
+}
+
+// NOTE(Ryan): A RELEASE fence before a RELAXED store (or ACQUIRE fence after a RELAXED load)
+// orders it like a RELEASE store, but for every subsequent store rather than one
+INTERNAL void
+atomic_fence(MEMORY_ORDER order)
+{
+  __atomic_thread_fence(order);
+}
+
+// NOTE(Ryan): Only stops compiler reordering; emits no instruction
+INTERNAL void
+atomic_compiler_fence(void)
+{
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+// NOTE(Ryan): Spin-wait hint.
+// Frees pipeline resources for sibling hyperthread and avoids memory order mis-speculation flush on loop exit
+INTERNAL void
+cpu_pause(void)
+{
+#if ARCH_X64 || ARCH_X86
+  __builtin_ia32_pause();
+#elif ARCH_ARM64 || ARCH_ARM32
+  asm volatile("yield" ::: "memory");
+#else
+  atomic_compiler_fence();
+#endif
+}
+
+#endif
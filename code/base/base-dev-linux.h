@@ -11,6 +11,7 @@
 #include <sys/resource.h>
 #include <sys/wait.h>
 #include <sys/stat.h> 
+#include <sys/mman.h>
 #include <unistd.h>
 #include <dirent.h> 
 #include <fcntl.h> 
@@ -665,7 +666,7 @@ linux_file_info(MemArena *arena, String8 file_name)
 
     struct stat file_stat = ZERO_STRUCT;
     // TODO(Ryan): handle symlinks, currently just look at symlink itself
-    if (fstatat(fd, buf, &file_stat, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == 0)
+    if (fstatat(AT_FDCWD, buf, &file_stat, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == 0)
     {
       if ((file_stat.st_mode & S_IFMT) == S_IFDIR) file_info.flags |= FILE_INFO_FLAG_DIRECTORY;
       if (file_stat.st_mode & S_IRUSR) file_info.flags |= FILE_INFO_FLAG_READ_ACCESS;
@@ -688,6 +689,51 @@ linux_file_info(MemArena *arena, String8 file_name)
   return file_info;
 }
 
+// NOTE(Ryan): Read-only private mapping; pages are shared with page cache so no copy made
+INTERNAL String8
+linux_map_entire_file(String8 file_name)
+{
+  String8 result = ZERO_STRUCT;
+
+  char buf[512] = ZERO_STRUCT;
+  str8_to_cstr(file_name, buf, sizeof(buf));
+
+  int fd = open(buf, O_RDONLY);
+  if (fd == -1)
+  {
+    WARN("Failed to open file %.*s\n\t%s\n", str8_varg(file_name), strerror(errno));
+    return result;
+  }
+
+  struct stat file_stat = ZERO_STRUCT;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+  {
+    void *mapping = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+      WARN("Failed to mmap file %.*s\n\t%s\n", str8_varg(file_name), strerror(errno));
+    }
+    else
+    {
+      result.content = (u8 *)mapping;
+      result.size = (u64)file_stat.st_size;
+    }
+  }
+
+  close(fd);
+
+  return result;
+}
+
+INTERNAL void
+linux_unmap_file(String8 mapping)
+{
+  if (mapping.content != NULL && munmap(mapping.content, mapping.size) != 0)
+  {
+    WARN("Failed to munmap file\n\t%s\n", strerror(errno));
+  }
+}
+
 #if 0
 typedef struct FileIter FileIter;
 struct FileIter
@@ -778,6 +824,127 @@ linux_page_fault_count(void)
   return result;
 }
 
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+
+typedef enum
+{
+  PERF_COUNTER_CYCLES = 0,
+  PERF_COUNTER_INSTRUCTIONS,
+  PERF_COUNTER_CACHE_MISSES,
+  PERF_COUNTER_BRANCH_MISSES,
+  PERF_COUNTER_PAGE_FAULTS,
+  PERF_COUNTER_COUNT
+} PERF_COUNTER;
+
+typedef struct PerfCounterValues PerfCounterValues;
+struct PerfCounterValues
+{
+  u64 v[PERF_COUNTER_COUNT];
+};
+
+// NOTE(Ryan): Counts calling thread only, as a single group so all counters cover same interval
+typedef struct LinuxPerfCounters LinuxPerfCounters;
+struct LinuxPerfCounters
+{
+  s32 fds[PERF_COUNTER_COUNT];
+  b32 is_open;
+  b32 is_valid;
+};
+
+// IMPORTANT(Ryan): Userspace only, so works with perf_event_paranoid <= 2.
+// If unavailable (e.g. VM, container), only page faults are reported through getrusage()
+INTERNAL void
+linux_perf_counters_open(LinuxPerfCounters *pc)
+{
+  pc->is_open = true;
+  pc->is_valid = true;
+
+  u32 types[PERF_COUNTER_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, 
+                                   PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+  u64 configs[PERF_COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                     PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS};
+  for (u32 i = 0; i < PERF_COUNTER_COUNT; i += 1)
+  {
+    struct perf_event_attr attr = ZERO_STRUCT;
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.disabled = (i == 0);
+
+    s32 group_fd = (i == 0) ? -1 : pc->fds[0];
+    pc->fds[i] = (s32)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    if (pc->fds[i] == -1)
+    {
+      for (u32 j = 0; j < i; j += 1) close(pc->fds[j]);
+      pc->is_valid = false;
+      return;
+    }
+  }
+
+  ioctl(pc->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(pc->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+INTERNAL void
+linux_perf_counters_close(LinuxPerfCounters *pc)
+{
+  if (pc->is_valid)
+  {
+    for (u32 i = 0; i < PERF_COUNTER_COUNT; i += 1) close(pc->fds[i]);
+  }
+  *pc = ZERO_STRUCT;
+}
+
+INTERNAL PerfCounterValues
+linux_perf_counters_read(LinuxPerfCounters *pc)
+{
+  PerfCounterValues result = ZERO_STRUCT;
+
+  if (pc->is_valid)
+  {
+    struct { u64 nr; u64 values[PERF_COUNTER_COUNT]; } group = ZERO_STRUCT;
+    if (read(pc->fds[0], &group, sizeof(group)) == (ssize_t)sizeof(group))
+    {
+      MEMORY_COPY(result.v, group.values, sizeof(result.v));
+    }
+  }
+  else
+  {
+    result.v[PERF_COUNTER_PAGE_FAULTS] = linux_page_fault_count();
+  }
+
+  return result;
+}
+
+INTERNAL void
+print_perf_counters(PerfCounterValues *values, u64 byte_count, b32 is_valid)
+{
+  if (is_valid)
+  {
+    u64 cycles = values->v[PERF_COUNTER_CYCLES];
+    f64 ipc = (cycles != 0) ? (f64)values->v[PERF_COUNTER_INSTRUCTIONS] / (f64)cycles : 0.0;
+    printf(" %.2f IPC", ipc);
+    if (byte_count != 0)
+    {
+      printf(", %.4f cache misses/byte", (f64)values->v[PERF_COUNTER_CACHE_MISSES] / (f64)byte_count);
+    }
+    else
+    {
+      printf(", %lu cache misses", values->v[PERF_COUNTER_CACHE_MISSES]);
+    }
+    printf(", %lu branch misses", values->v[PERF_COUNTER_BRANCH_MISSES]);
+  }
+
+  u64 faults = values->v[PERF_COUNTER_PAGE_FAULTS];
+  printf(", %lu faults", faults);
+  if (faults != 0 && byte_count != 0) printf(" (%.2fkb/fault)", (f64)byte_count / ((f64)faults * 1024.0));
+}
+
 INTERNAL b32
 linux_rename_file(String8 og_name, String8 new_name)
 {
@@ -24,13 +24,18 @@
 #endif
 
 #if PLATFORM_LINUX || PLATFORM_MAC || PLATFORM_WINDOWS
+  #include "base/base-atomic.h"
   #include "base/base-file.h"
   #include "base/base-repetition.h"
+  // NOTE(Ryan): Threads before profiler, as trace export streams through a RingSPSC
+  #if PLATFORM_LINUX
+    #include "base/base-thread.h"
+  #endif
   #include "base/base-profiler.h"
 #endif
 
-
-// TODO(Ryan):
-// #include "base-thread.h"
+#if PLATFORM_LINUX
+  #include "base/base-job.h"
+#endif
 
 #endif
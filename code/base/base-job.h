@@ -0,0 +1,413 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#if !defined(BASE_JOB_H)
+#define BASE_JOB_H
+
+// NOTE(Ryan): Work-stealing job system.
+// One worker per logical core, with main thread being worker 0.
+// Each worker owns a Chase-Lev deque; owner pushes/pops at bottom, thieves steal from top.
+// Completion is tracked with counters, and waiting on one runs other jobs instead of blocking
+
+#include <sched.h>
+
+#define JOB_DEQUE_SIZE KB(4)
+#define JOBS_MAX_WORKERS 64
+#define JOB_SPIN_COUNT 64
+
+typedef void job_function(void *data);
+
+typedef struct JobCounter JobCounter;
+struct JobCounter
+{
+  u32 volatile pending;
+};
+
+typedef struct JobWorker JobWorker;
+typedef struct Job Job;
+typedef void job_run_function(JobWorker *worker, Job *job);
+
+// IMPORTANT(Ryan): run is the submitting image's job_run(), so job executes with that image's thread locals.
+// Matters for hot reloading, as host and reloadable code have separate copies of them
+struct Job
+{
+  job_function *func;
+  void *data;
+  JobCounter *counter;
+  job_run_function *run;
+};
+
+// NOTE(Ryan): Jobs stored by value. A thief may read a slot being overwritten, however its CAS on top then fails
+typedef struct JobDeque JobDeque;
+struct JobDeque
+{
+  s64 volatile top;
+  u8 pad[CACHE_LINE_SIZE - sizeof(s64)];
+  s64 volatile bottom;
+  Job jobs[JOB_DEQUE_SIZE];
+};
+
+typedef struct JobSystem JobSystem;
+struct JobWorker
+{
+  JobDeque deque;
+  JobSystem *js;
+  ThreadContext *tctx;
+  thread_handle thread;
+  u32 index;
+  u32 steal_seed;
+};
+
+struct JobSystem
+{
+  JobWorker *workers;
+  u32 worker_count;
+  pid_t main_thread_id;
+
+  // NOTE(Ryan): Queued but not yet taken, so idle workers know when to sleep
+  u32 volatile queued_count;
+  u32 volatile sleeping_count;
+  thread_mutex sleep_mutex;
+  thread_cv sleep_cv;
+  b32 volatile is_quitting;
+};
+
+THREAD_LOCAL JobWorker *tl_job_worker;
+
+INTERNAL b32
+job_deque_push(JobDeque *d, Job *job)
+{
+  s64 b = atomic_s64_load(&d->bottom, MEMORY_ORDER_RELAXED);
+  s64 t = atomic_s64_load_acquire(&d->top);
+  if (b - t >= JOB_DEQUE_SIZE) return false;
+
+  d->jobs[b & (JOB_DEQUE_SIZE - 1)] = *job;
+  atomic_fence(MEMORY_ORDER_RELEASE);
+  atomic_s64_store(&d->bottom, b + 1, MEMORY_ORDER_RELAXED);
+
+  return true;
+}
+
+// NOTE(Ryan): Owner only
+INTERNAL b32
+job_deque_pop(JobDeque *d, Job *job)
+{
+  s64 b = atomic_s64_load(&d->bottom, MEMORY_ORDER_RELAXED) - 1;
+  atomic_s64_store(&d->bottom, b, MEMORY_ORDER_RELAXED);
+  // IMPORTANT(Ryan): Store to bottom must be visible before top is read, which only a full fence gives
+  atomic_fence(MEMORY_ORDER_SEQ_CST);
+  s64 t = atomic_s64_load(&d->top, MEMORY_ORDER_RELAXED);
+
+  b32 result = false;
+  if (t <= b)
+  {
+    *job = d->jobs[b & (JOB_DEQUE_SIZE - 1)];
+    result = true;
+    // NOTE(Ryan): Last job, so race thieves for it
+    if (t == b)
+    {
+      result = atomic_s64_cas(&d->top, &t, t + 1, MEMORY_ORDER_SEQ_CST, MEMORY_ORDER_RELAXED);
+      atomic_s64_store(&d->bottom, b + 1, MEMORY_ORDER_RELAXED);
+    }
+  }
+  else
+  {
+    atomic_s64_store(&d->bottom, b + 1, MEMORY_ORDER_RELAXED);
+  }
+
+  return result;
+}
+
+INTERNAL b32
+job_deque_steal(JobDeque *d, Job *job)
+{
+  s64 t = atomic_s64_load_acquire(&d->top);
+  atomic_fence(MEMORY_ORDER_SEQ_CST);
+  s64 b = atomic_s64_load_acquire(&d->bottom);
+
+  if (t >= b) return false;
+
+  *job = d->jobs[t & (JOB_DEQUE_SIZE - 1)];
+  return atomic_s64_cas(&d->top, &t, t + 1, MEMORY_ORDER_SEQ_CST, MEMORY_ORDER_RELAXED);
+}
+
+INTERNAL void
+job_run(JobWorker *worker, Job *job)
+{
+  JobWorker *prev_worker = tl_job_worker;
+  ThreadContext *prev_tctx = thread_context_get();
+  tl_job_worker = worker;
+  thread_context_set(worker->tctx);
+
+  job->func(job->data);
+
+  tl_job_worker = prev_worker;
+  thread_context_set(prev_tctx);
+
+  // NOTE(Ryan): Release pairs with job_wait()'s acquire, so job's writes are visible to waiter
+  if (job->counter != NULL) atomic_u32_fetch_sub(&job->counter->pending, 1, MEMORY_ORDER_RELEASE);
+}
+
+// IMPORTANT(Ryan): Only main thread may adopt worker 0, as its deque is owner-only.
+// Checked by id, as reloadable code's own ThreadContext is unset until it adopts worker 0's
+INTERNAL JobWorker *
+job_worker_get(JobSystem *js)
+{
+  if (tl_job_worker == NULL)
+  {
+    ASSERT(thread_get_id() == js->main_thread_id);
+    tl_job_worker = &js->workers[0];
+    if (thread_context_get() == NULL) thread_context_set(tl_job_worker->tctx);
+  }
+  return tl_job_worker;
+}
+
+// NOTE(Ryan): Own deque first, then steal from others starting at a random victim
+INTERNAL b32
+job_find(JobWorker *worker, Job *job)
+{
+  JobSystem *js = worker->js;
+
+  b32 result = job_deque_pop(&worker->deque, job);
+  if (!result && js->worker_count > 1)
+  {
+    u32 start = u32_rand(&worker->steal_seed) % js->worker_count;
+    for (u32 i = 0; i < js->worker_count && !result; i += 1)
+    {
+      JobWorker *victim = &js->workers[(start + i) % js->worker_count];
+      if (victim == worker) continue;
+      result = job_deque_steal(&victim->deque, job);
+    }
+  }
+
+  // NOTE(Ryan): Only the increment takes part in the sleep handshake
+  if (result) atomic_u32_fetch_sub(&js->queued_count, 1, MEMORY_ORDER_RELAXED);
+
+  return result;
+}
+
+INTERNAL b32
+job_try_run_one(JobWorker *worker)
+{
+  Job job = ZERO_STRUCT;
+  b32 result = job_find(worker, &job);
+  if (result) job.run(worker, &job);
+  return result;
+}
+
+// NOTE(Ryan): Runs inline if the worker's deque is full
+INTERNAL void
+job_submit(JobSystem *js, job_function *func, void *data, JobCounter *counter)
+{
+  JobWorker *worker = job_worker_get(js);
+
+  Job job = ZERO_STRUCT;
+  job.func = func;
+  job.data = data;
+  job.counter = counter;
+  job.run = job_run;
+  if (counter != NULL) atomic_u32_fetch_add(&counter->pending, 1, MEMORY_ORDER_RELAXED);
+
+  // IMPORTANT(Ryan): SEQ_CST so the sleeper check below can't be ordered before this increment.
+  // Pairs with job_worker_thread() incrementing sleeping_count before checking queued_count
+  atomic_u32_fetch_add(&js->queued_count, 1, MEMORY_ORDER_SEQ_CST);
+  if (!job_deque_push(&worker->deque, &job))
+  {
+    atomic_u32_fetch_sub(&js->queued_count, 1, MEMORY_ORDER_RELAXED);
+    job_run(worker, &job);
+    return;
+  }
+
+  if (atomic_u32_load(&js->sleeping_count, MEMORY_ORDER_SEQ_CST) > 0)
+  {
+    thread_mutex_lock(&js->sleep_mutex);
+    thread_cv_signal(&js->sleep_cv);
+    thread_mutex_unlock(&js->sleep_mutex);
+  }
+}
+
+// NOTE(Ryan): Helps with any job while waiting, so nested waits from within jobs can't deadlock
+INTERNAL void
+job_wait(JobSystem *js, JobCounter *counter)
+{
+  JobWorker *worker = job_worker_get(js);
+  while (atomic_u32_load_acquire(&counter->pending) != 0)
+  {
+    if (!job_try_run_one(worker)) thread_yield();
+  }
+}
+
+INTERNAL void *
+job_worker_thread(void *params)
+{
+  JobWorker *worker = (JobWorker *)params;
+  JobSystem *js = worker->js;
+
+  tl_job_worker = worker;
+  thread_context_set(worker->tctx);
+
+  u32 idle_count = 0;
+  while (!atomic_u32_load(&js->is_quitting, MEMORY_ORDER_RELAXED))
+  {
+    if (job_try_run_one(worker))
+    {
+      idle_count = 0;
+      continue;
+    }
+
+    if (++idle_count < JOB_SPIN_COUNT)
+    {
+      if (idle_count < JOB_SPIN_COUNT / 2) cpu_pause();
+      else thread_yield();
+      continue;
+    }
+
+    // NOTE(Ryan): Sleeper count is published before checking queue, so a submit can't be missed
+    thread_mutex_lock(&js->sleep_mutex);
+    atomic_u32_fetch_add(&js->sleeping_count, 1, MEMORY_ORDER_SEQ_CST);
+    while (atomic_u32_load(&js->queued_count, MEMORY_ORDER_SEQ_CST) == 0 &&
+           !atomic_u32_load(&js->is_quitting, MEMORY_ORDER_RELAXED))
+    {
+      thread_cv_wait(&js->sleep_cv, &js->sleep_mutex);
+    }
+    atomic_u32_fetch_sub(&js->sleeping_count, 1, MEMORY_ORDER_RELAXED);
+    thread_mutex_unlock(&js->sleep_mutex);
+    idle_count = 0;
+  }
+
+  return NULL;
+}
+
+// NOTE(Ryan): Chunk boundaries depend only on chunk size, and outputs are read back in chunk order.
+// So, provided a chunk only writes its own elements and outputs, results don't depend on which
+// worker ran what. Each element may emit at most one output
+typedef struct ParallelFor ParallelFor;
+typedef struct ParallelChunk ParallelChunk;
+struct ParallelChunk
+{
+  ParallelFor *pf;
+  u32 index;
+  u32 first, end;
+  // NOTE(Ryan): Executing worker's scratch, reset after chunk returns
+  MemArena *scratch;
+  u8 *output;
+  u32 output_count;
+};
+
+typedef void parallel_for_function(ParallelChunk *chunk, void *data);
+
+struct ParallelFor
+{
+  ParallelChunk *chunks;
+  u32 chunk_count;
+  u64 output_elem_size;
+  parallel_for_function *func;
+  void *data;
+};
+
+#define PARALLEL_CHUNK_PUSH_OUTPUT(chunk, T) ((T *)(chunk)->output + (chunk)->output_count++)
+#define PARALLEL_CHUNK_OUTPUT(chunk, T, i) ((T *)(chunk)->output + (i))
+
+INTERNAL void
+parallel_for_chunk_job(void *data)
+{
+  ParallelChunk *chunk = (ParallelChunk *)data;
+  MemArenaTemp temp = mem_arena_temp_begin(NULL, 0);
+  chunk->scratch = temp.arena;
+  chunk->pf->func(chunk, chunk->pf->data);
+  chunk->scratch = NULL;
+  mem_arena_temp_end(temp);
+}
+
+// NOTE(Ryan): chunk_size of 0 splits into a few chunks per worker.
+// ParallelFor and outputs are pushed onto arena, which only calling thread touches
+INTERNAL ParallelFor *
+parallel_for(JobSystem *js, MemArena *arena, u32 first, u32 end, u32 chunk_size, u64 output_elem_size,
+             parallel_for_function *func, void *data)
+{
+  ParallelFor *pf = MEM_ARENA_PUSH_STRUCT_ZERO(arena, ParallelFor);
+  pf->output_elem_size = output_elem_size;
+  pf->func = func;
+  pf->data = data;
+  if (end <= first) return pf;
+
+  u32 count = end - first;
+  if (chunk_size == 0) chunk_size = MAX(1, count / (js->worker_count * 4));
+  pf->chunk_count = (count + chunk_size - 1) / chunk_size;
+  pf->chunks = MEM_ARENA_PUSH_ARRAY_ZERO(arena, ParallelChunk, pf->chunk_count);
+  u8 *outputs = (output_elem_size != 0) ? MEM_ARENA_PUSH_ARRAY(arena, u8, output_elem_size * count) : NULL;
+
+  JobCounter counter = ZERO_STRUCT;
+  for (u32 i = 0; i < pf->chunk_count; i += 1)
+  {
+    ParallelChunk *chunk = &pf->chunks[i];
+    chunk->pf = pf;
+    chunk->index = i;
+    chunk->first = first + i * chunk_size;
+    chunk->end = MIN(chunk->first + chunk_size, end);
+    if (outputs != NULL) chunk->output = outputs + (chunk->first - first) * output_elem_size;
+    job_submit(js, parallel_for_chunk_job, chunk, &counter);
+  }
+  job_wait(js, &counter);
+
+  return pf;
+}
+
+// NOTE(Ryan): Worker i is pinned to core i, leaving main thread to the scheduler
+INTERNAL void
+job_system_start(JobSystem *js, MemArena *arena, ThreadContext *main_tctx, u32 worker_count)
+{
+  worker_count = CLAMP(1, worker_count, JOBS_MAX_WORKERS);
+
+  js->workers = MEM_ARENA_PUSH_ARRAY_ZERO(arena, JobWorker, worker_count);
+  js->worker_count = worker_count;
+  js->main_thread_id = thread_get_id();
+  thread_mutex_init(&js->sleep_mutex);
+  thread_cv_init(&js->sleep_cv);
+
+  for (u32 i = 0; i < worker_count; i += 1)
+  {
+    JobWorker *worker = &js->workers[i];
+    worker->js = js;
+    worker->index = i;
+    worker->steal_seed = 0x9E3779B9u ^ (i + 1);
+    if (i == 0)
+    {
+      worker->tctx = main_tctx;
+      continue;
+    }
+
+    worker->tctx = MEM_ARENA_PUSH_STRUCT_ZERO(arena, ThreadContext);
+    *worker->tctx = thread_context_allocate(MB(64), MB(1));
+    worker->tctx->thread_name_size = (u32)snprintf(worker->tctx->thread_name, sizeof(worker->tctx->thread_name), 
+                                                   "Job Worker %u", i);
+
+    worker->thread = start_joinable_thread(job_worker_thread, worker);
+    if (worker->thread != 0)
+    {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % linux_logical_cores(), &cpus);
+      if (pthread_setaffinity_np(worker->thread, sizeof(cpus), &cpus) != 0)
+        WARN("Failed to pin job worker %u", i);
+    }
+  }
+}
+
+// NOTE(Ryan): Waits for workers to exit, so state they reference can be torn down afterwards.
+// Jobs still queued are dropped
+INTERNAL void
+job_system_stop(JobSystem *js)
+{
+  thread_mutex_lock(&js->sleep_mutex);
+  atomic_u32_store(&js->is_quitting, true, MEMORY_ORDER_RELAXED);
+  thread_mutex_unlock(&js->sleep_mutex);
+  thread_cv_signal_all(&js->sleep_cv);
+
+  for (u32 i = 1; i < js->worker_count; i += 1)
+  {
+    if (js->workers[i].thread != 0) thread_join(js->workers[i].thread);
+  }
+  thread_cv_destroy(&js->sleep_cv);
+  thread_mutex_destroy(&js->sleep_mutex);
+}
+
+#endif
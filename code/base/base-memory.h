@@ -24,40 +24,191 @@
 
 #define MEMORY_MATCH(a, b, n) (memcmp((a), (b), (n)) == 0)
 
+#define CACHE_LINE_SIZE 64
+
 #define KB(x) ((x) << 10)
 #define MB(x) ((x) << 20)
 #define GB(x) (((u64)x) << 30)
 #define TB(x) (((u64)x) << 40)
 
+// NOTE(Ryan): Address space is reserved up-front and only backed with pages as it's used.
+// So, large caps are free and untouched pages never count towards RSS
+#if PLATFORM_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+
+INTERNAL void *
+mem_reserve(memory_index size)
+{
+  void *result = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (result == MAP_FAILED) result = NULL;
+  return result;
+}
+
+INTERNAL b32
+mem_commit(void *ptr, memory_index size)
+{
+  return (mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0);
+}
+
+// IMPORTANT(Ryan): Pages read back as zero when recommitted
+INTERNAL void
+mem_decommit(void *ptr, memory_index size)
+{
+  madvise(ptr, size, MADV_DONTNEED);
+  mprotect(ptr, size, PROT_NONE);
+}
+
+INTERNAL void
+mem_release(void *ptr, memory_index size)
+{
+  munmap(ptr, size);
+}
+
+// NOTE(Ryan): Same pages mapped twice back to back, so any span of up to size bytes
+// starting within [0, size) is contiguous, i.e. no wrap handling.
+// size must be a multiple of page size
+INTERNAL u8 *
+mem_magic_ring_allocate(memory_index size)
+{
+  s32 fd = memfd_create("magic-ring", MFD_CLOEXEC);
+  if (fd == -1) return NULL;
+
+  u8 *result = NULL;
+  if (ftruncate(fd, (off_t)size) == 0)
+  {
+    // IMPORTANT(Ryan): Reserve both halves first, so nothing else can be mapped in between
+    u8 *base = (u8 *)mem_reserve(size * 2);
+    if (base != NULL)
+    {
+      void *lo = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+      void *hi = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+      if (lo == base && hi == base + size) result = base;
+      else mem_release(base, size * 2);
+    }
+  }
+  close(fd);
+
+  return result;
+}
+
+INTERNAL void
+mem_magic_ring_release(u8 *base, memory_index size)
+{
+  mem_release(base, size * 2);
+}
+#else
+INTERNAL void *mem_reserve(memory_index size) { return malloc(size); }
+INTERNAL b32 mem_commit(void *ptr, memory_index size) { return true; }
+INTERNAL void mem_decommit(void *ptr, memory_index size) { MEMORY_ZERO(ptr, size); }
+INTERNAL void mem_release(void *ptr, memory_index size) { free(ptr); }
+INTERNAL u8 *mem_magic_ring_allocate(memory_index size) { return NULL; }
+INTERNAL void mem_magic_ring_release(u8 *base, memory_index size) {}
+#endif
+
+typedef u32 MEM_ARENA_FLAG;
+enum
+{
+  // NOTE(Ryan): Link a new block when current one fills, rather than failing
+  MEM_ARENA_FLAG_CHAIN = (1 << 0),
+};
+
+// NOTE(Ryan): An arena is a chain of blocks, each prefixed with this header.
+// Positions are absolute across chain, i.e. block's base_pos + its own pos
 typedef struct MemArena MemArena;
 struct MemArena
 {
+  // NOTE(Ryan): Base of block reservation, i.e. header lives at start
   void *memory;
   memory_index commit_pos;
+  memory_index commit_granularity;
   memory_index max;
   memory_index pos;
   memory_index align;
+
+  MemArena *prev;
+  memory_index base_pos;
+
+  // NOTE(Ryan): Only valid on first block
+  MemArena *current;
+  MEM_ARENA_FLAG flags;
+  u32 block_count;
+  memory_index high_water;
+  u32 failed_push_count;
 };
 
+// IMPORTANT(Ryan): Pushes return NULL on failure after calling this.
+// Per module, so host and reloadable code each set their own
+typedef void (*mem_arena_failure_hook_t)(MemArena *arena, memory_index size);
+GLOBAL mem_arena_failure_hook_t g_mem_arena_failure_hook;
+
+INTERNAL b32
+mem_arena_commit_to(MemArena *block, memory_index pos)
+{
+  if (pos <= block->commit_pos) return true;
+
+  memory_index new_commit_pos = memory_index_round_to_nearest(pos, block->commit_granularity);
+  new_commit_pos = CLAMP_TOP(new_commit_pos, block->max);
+  if (!mem_commit((u8 *)block->memory + block->commit_pos, new_commit_pos - block->commit_pos)) return false;
+
+  block->commit_pos = new_commit_pos;
+  return true;
+}
+
 INTERNAL MemArena *
-mem_arena_allocate(memory_index cap, memory_index roundup_granularity)
+mem_arena_block_allocate(memory_index cap, memory_index roundup_granularity)
 {
   u64 rounded_size = memory_index_round_to_nearest(cap, roundup_granularity);
-  MemArena *result = (MemArena *)malloc(rounded_size);
-  if (result == NULL) return result;
+  void *memory = mem_reserve(rounded_size);
+  if (memory == NULL) return NULL;
 
-  result->memory = result + sizeof(MemArena);
-  result->max = cap;
+  u64 initial_commit = memory_index_round_to_nearest(sizeof(MemArena), roundup_granularity);
+  if (!mem_commit(memory, initial_commit))
+  {
+    mem_release(memory, rounded_size);
+    return NULL;
+  }
+
+  MemArena *result = (MemArena *)memory;
+  result->memory = memory;
+  result->commit_pos = initial_commit;
+  result->commit_granularity = roundup_granularity;
+  result->max = rounded_size;
   result->pos = sizeof(MemArena);
   result->align = sizeof(memory_index);
 
   return result;
 }
 
+// IMPORTANT(Ryan): roundup_granularity is commit chunk size, so must be a multiple of page size
+INTERNAL MemArena *
+mem_arena_allocate_flags(memory_index cap, memory_index roundup_granularity, MEM_ARENA_FLAG flags)
+{
+  MemArena *result = mem_arena_block_allocate(cap, roundup_granularity);
+  if (result == NULL) return result;
+
+  result->current = result;
+  result->flags = flags;
+  result->block_count = 1;
+  result->high_water = result->pos;
+
+  return result;
+}
+
+INTERNAL MemArena *
+mem_arena_allocate(memory_index cap, memory_index roundup_granularity)
+{
+  return mem_arena_allocate_flags(cap, roundup_granularity, MEM_ARENA_FLAG_CHAIN);
+}
+
 INTERNAL void
 mem_arena_deallocate(MemArena *arena)
 {
-  free(arena);
+  for (MemArena *block = arena->current, *prev = NULL; block != NULL; block = prev)
+  {
+    prev = block->prev;
+    mem_release(block->memory, block->max);
+  }
 }
  
 #define MEM_ARENA_PUSH_ARRAY(a,T,c) (T*)mem_arena_push((a), sizeof(T)*(c))
@@ -67,29 +218,63 @@ mem_arena_deallocate(MemArena *arena)
 #define MEM_ARENA_PUSH_STRUCT(a,T) (T*)mem_arena_push((a), sizeof(T))
 #define MEM_ARENA_PUSH_STRUCT_ZERO(a,T) (T*)mem_arena_push_zero((a), sizeof(T))
 
-INTERNAL void *
-mem_arena_push_aligned(MemArena *arena, memory_index size, memory_index align)
+INTERNAL memory_index
+mem_arena_pos(MemArena *arena)
 {
-  memory_index clamped_align = CLAMP_BOTTOM(align, arena->align);
+  MemArena *current = arena->current;
+  return current->base_pos + current->pos;
+}
 
-  memory_index pos = arena->pos;
+INTERNAL void *
+mem_arena_block_push(MemArena *block, memory_index size, memory_index align)
+{
+  memory_index pos = block->pos;
 
-  memory_index pos_address = INT_FROM_PTR(arena) + pos;
-  memory_index aligned_pos = ALIGN_POW2_UP(pos_address, clamped_align);
+  memory_index pos_address = INT_FROM_PTR(block) + pos;
+  memory_index aligned_pos = ALIGN_POW2_UP(pos_address, align);
   memory_index alignment_size = aligned_pos - pos_address;
+  memory_index new_pos = pos + alignment_size + size;
+
+  if (new_pos > block->max || !mem_arena_commit_to(block, new_pos)) return NULL;
+
+  block->pos = new_pos;
+  return (u8 *)block + pos + alignment_size;
+}
+
+INTERNAL void *
+mem_arena_push_aligned(MemArena *arena, memory_index size, memory_index align)
+{
+  memory_index clamped_align = CLAMP_BOTTOM(align, arena->align);
 
-  if (pos + alignment_size + size <= arena->max)
+  void *result = mem_arena_block_push(arena->current, size, clamped_align);
+  if (result == NULL && HAS_FLAGS_ANY(arena->flags, MEM_ARENA_FLAG_CHAIN))
   {
-    memory_index new_pos = pos + alignment_size + size;
-    arena->pos = new_pos;
+    // NOTE(Ryan): Oversized pushes get a block to themselves
+    MemArena *current = arena->current;
+    memory_index block_cap = MAX(arena->max, sizeof(MemArena) + clamped_align + size);
+    MemArena *block = mem_arena_block_allocate(block_cap, arena->commit_granularity);
+    if (block != NULL)
+    {
+      block->align = arena->align;
+      block->prev = current;
+      block->base_pos = current->base_pos + current->max;
+      arena->current = block;
+      arena->block_count += 1;
 
-    return (u8 *)arena + pos + alignment_size;
+      result = mem_arena_block_push(block, size, clamped_align);
+    }
   }
-  else
+
+  if (result == NULL)
   {
-    // TODO(Ryan): Handle out-of-memory (conceivable on say limited VPS, etc.)
-    return (u8 *)arena + pos;
+    arena->failed_push_count += 1;
+    if (g_mem_arena_failure_hook != NULL) g_mem_arena_failure_hook(arena, size);
+    return result;
   }
+
+  arena->high_water = MAX(arena->high_water, mem_arena_pos(arena));
+
+  return result;
 }
 
 INTERNAL void *
@@ -103,42 +288,143 @@ mem_arena_push_zero(MemArena *arena, memory_index size)
 {
   void *memory = mem_arena_push(arena, size);
 
-  MEMORY_ZERO(memory, size);
+  if (memory != NULL) MEMORY_ZERO(memory, size);
 
   return memory;
 }
 
+// NOTE(Ryan): Blocks wholly past pos are released
 INTERNAL void
 mem_arena_set_pos_back(MemArena *arena, memory_index pos)
 {
   memory_index clamped_pos = CLAMP_BOTTOM(sizeof(*arena), pos);
 
-  if (arena->pos > clamped_pos)
+  MemArena *current = arena->current;
+  while (current->base_pos >= clamped_pos && current->prev != NULL)
+  {
+    MemArena *prev = current->prev;
+    mem_release(current->memory, current->max);
+    arena->block_count -= 1;
+    current = prev;
+  }
+  arena->current = current;
+
+  memory_index block_pos = CLAMP_BOTTOM(sizeof(*current), clamped_pos - current->base_pos);
+  if (current->pos > block_pos)
   {
-    arena->pos = clamped_pos;
+    current->pos = block_pos;
   }
 }
 
 INTERNAL void
 mem_arena_pop(MemArena *arena, memory_index size)
 {
-  mem_arena_set_pos_back(arena, arena->pos - size);
+  mem_arena_set_pos_back(arena, mem_arena_pos(arena) - size);
 }
 
 INTERNAL void
 mem_arena_reset(MemArena *arena)
 {
-  mem_arena_pop(arena, arena->pos);
+  mem_arena_set_pos_back(arena, 0);
 }
 
+// NOTE(Ryan): Only first commit chunk is zeroed; the rest is handed back to the OS,
+// which zero-fills on next touch, i.e. no memset of a whole frame's worth of memory
 INTERNAL void
 mem_arena_clear(MemArena *arena)
 {
-  memory_index cur_pos = arena->pos;
-  mem_arena_pop(arena, cur_pos);
-  MEMORY_ZERO(arena->memory, cur_pos - arena->pos);
+  memory_index cur_pos = (arena->current == arena) ? arena->pos : arena->max;
+  mem_arena_reset(arena);
+
+  memory_index keep_pos = CLAMP_TOP(arena->commit_granularity, arena->commit_pos);
+  if (arena->commit_pos > keep_pos)
+  {
+    mem_decommit((u8 *)arena->memory + keep_pos, arena->commit_pos - keep_pos);
+    arena->commit_pos = keep_pos;
+  }
+
+  memory_index zero_end = MIN(cur_pos, keep_pos);
+  if (zero_end > arena->pos) MEMORY_ZERO((u8 *)arena->memory + arena->pos, zero_end - arena->pos);
+}
+
+// NOTE(Ryan): Fixed-size elements recycled through an intrusive free list.
+// Pool owns its arena, so a reset rewinds just the pool's memory without zeroing it
+#define MEM_POOL_COMMIT_GRANULARITY KB(64)
+
+typedef struct MemPoolFreeNode MemPoolFreeNode;
+struct MemPoolFreeNode
+{
+  MemPoolFreeNode *next;
+};
+
+typedef struct MemPool MemPool;
+struct MemPool
+{
+  MemArena *arena;
+  memory_index elem_size;
+  memory_index elem_align;
+  MemPoolFreeNode *free_list;
+  u32 count;
+};
+
+// NOTE(Ryan): cap is size of first block; more are chained on demand
+INTERNAL MemPool
+mem_pool_create(memory_index cap, memory_index elem_size, memory_index elem_align)
+{
+  MemPool pool = ZERO_STRUCT;
+  pool.arena = mem_arena_allocate(cap, MEM_POOL_COMMIT_GRANULARITY);
+  pool.elem_size = MAX(elem_size, sizeof(MemPoolFreeNode));
+  pool.elem_align = MAX(elem_align, alignof(MemPoolFreeNode));
+  return pool;
+}
+
+INTERNAL void *
+mem_pool_alloc(MemPool *pool)
+{
+  void *result = pool->free_list;
+  if (result != NULL) SLL_STACK_POP(pool->free_list);
+  else if (pool->arena != NULL) result = mem_arena_push_aligned(pool->arena, pool->elem_size, pool->elem_align);
+
+  if (result != NULL) pool->count += 1;
+
+  return result;
+}
+
+INTERNAL void *
+mem_pool_alloc_zero(MemPool *pool)
+{
+  void *result = mem_pool_alloc(pool);
+  if (result != NULL) MEMORY_ZERO(result, pool->elem_size);
+  return result;
+}
+
+INTERNAL void
+mem_pool_free(MemPool *pool, void *elem)
+{
+  MemPoolFreeNode *node = (MemPoolFreeNode *)elem;
+  SLL_STACK_PUSH(pool->free_list, node);
+  pool->count -= 1;
+}
+
+// IMPORTANT(Ryan): Frees all elements at once without touching their memory
+INTERNAL void
+mem_pool_reset(MemPool *pool)
+{
+  pool->free_list = NULL;
+  pool->count = 0;
+  if (pool->arena != NULL) mem_arena_reset(pool->arena);
+}
+
+INTERNAL void
+mem_pool_release(MemPool *pool)
+{
+  if (pool->arena != NULL) mem_arena_deallocate(pool->arena);
+  MEMORY_ZERO_STRUCT(pool);
 }
 
+#define MEM_POOL_CREATE(cap,T) mem_pool_create((cap), sizeof(T), alignof(T))
+#define MEM_POOL_ALLOC(p,T) (T*)mem_pool_alloc((p))
+#define MEM_POOL_ALLOC_ZERO(p,T) (T*)mem_pool_alloc_zero((p))
 
 typedef struct ThreadContext ThreadContext;
 struct ThreadContext
@@ -234,7 +520,7 @@ mem_arena_temp_begin(MemArena **conflicts, u32 conflict_count)
     if (is_conflicting == 0)
     {
       temp.arena = tctx->arenas[tctx_idx];
-      temp.pos = temp.arena->pos;
+      temp.pos = mem_arena_pos(temp.arena);
       break;
     }
   }
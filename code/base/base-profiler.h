@@ -3,25 +3,40 @@
 #define BASE_PROFILER_H
 
 #if defined(PROFILER)
-  #if defined(__GNUC_INSTRUMENTATION__)
-    ProfileEphemeral ephemerals[4096];
-    GLOBAL AddressIndexSlot g_address_index_slots;
-    void __cyg_profile_func_enter(void *this_fn, void *call_site) __attribute__((no_instrument_function));
-    void __cyg_profile_func_enter(void *this_fn, void *call_site)
-    {
-      u32 ephemeral_slot = ptr_hash(this_fn) % ARRAY_COUNT(g_ephemerals);
-      ProfileEphemeral *e = g_ephemerals[ephemeral_slot];
-      ASSERT("Hash collision not encountered" && e->addr == this_fn);
-      profile_block_start(ephemeral_slot);
-    }   
-    void __cyg_profile_func_exit(void *this_fn, void *call_site) __attribute__((no_instrument_function));
-    void __cyg_profile_func_exit(void *this_fn, void *call_site)
-    {
-      u32 ephemeral_slot = ptr_hash(this_fn) % ARRAY_COUNT(g_ephemerals);
-      ProfileEphemeral *e = g_ephemerals[ephemeral_slot];
-      profile_block_end(e);
-    }
- #endif
+  // NOTE(Ryan): Automatic mode is for -finstrument-functions builds, i.e. param_profile=auto.
+  // Every function entry/exit is a block, with its slot found by hashing function address
+  #if !defined(PROFILER_AUTO)
+    #define PROFILER_AUTO 0
+  #endif
+
+  #define PROFILER_MANUAL_SLOTS 1024
+  #if PROFILER_AUTO
+    #define PROFILER_AUTO_SLOTS 4096
+    #define PROFILER_AUTO_MAX_DEPTH 256
+  #else
+    #define PROFILER_AUTO_SLOTS 0
+  #endif
+  #define PROFILER_MAX_SLOTS (PROFILER_MANUAL_SLOTS + PROFILER_AUTO_SLOTS)
+
+  // NOTE(Ryan): Hardware counters per block, i.e. instructions, cache/branch misses and page faults.
+  // Off by default, as each block start/end becomes a read() syscall
+  #if !defined(PROFILER_PERF_COUNTERS)
+    #define PROFILER_PERF_COUNTERS 0
+  #endif
+
+  // NOTE(Ryan): Timeline keeps last PROFILER_MAX_EVENTS blocks per thread for trace export
+  #if !defined(PROFILER_TIMELINE)
+    #define PROFILER_TIMELINE 1
+  #endif
+  #define PROFILER_MAX_EVENTS KB(64)
+
+  typedef struct ProfileEvent ProfileEvent;
+  struct ProfileEvent
+  {
+    const char *label;
+    u64 start;
+    u64 elapsed;
+  };
 
   typedef struct ProfileSlot ProfileSlot;
   struct ProfileSlot
@@ -31,16 +46,11 @@
     u64 hit_count;
     u64 byte_count;
     const char *label;
+  #if PROFILER_PERF_COUNTERS
+    PerfCounterValues perf;
+  #endif
   };
-  
-  typedef struct Profiler Profiler;
-  struct Profiler
-  {
-    ProfileSlot slots[4096];
-    u64 start;
-    u64 end;
-  };
-  
+
   typedef struct ProfileEphemeral ProfileEphemeral;
   struct ProfileEphemeral
   {
@@ -49,10 +59,80 @@
     u64 start;
     u32 parent_slot_index;
     u32 slot_index; 
+  #if PROFILER_PERF_COUNTERS
+    PerfCounterValues old_perf;
+    PerfCounterValues perf_start;
+  #endif
+  };
+  
+  // NOTE(Ryan): Each thread accumulates into its own slots, so no contention on hot path.
+  // Registered once into a lock-free list that is walked at print time
+  typedef struct ProfileThread ProfileThread;
+  struct ProfileThread
+  {
+    ProfileThread *next;
+    ProfileSlot slots[PROFILER_MAX_SLOTS];
+    u32 parent_slot_index;
+    char name[32];
+    u32 id;
+  #if PROFILER_TIMELINE
+    ProfileEvent events[PROFILER_MAX_EVENTS];
+    u64 event_count;
+  #endif
+  #if PROFILER_AUTO
+    ProfileEphemeral auto_stack[PROFILER_AUTO_MAX_DEPTH];
+    u32 auto_depth;
+  #endif
+  #if PROFILER_PERF_COUNTERS
+    LinuxPerfCounters perf;
+  #endif
+  };
+  
+  // NOTE(Ryan): Per-frame inclusive time of the first PROFILER_HISTORY_SLOTS slots of the snapshotting thread
+  #define PROFILER_HISTORY_FRAMES 128
+  #define PROFILER_HISTORY_SLOTS 64
+
+  typedef struct ProfileFrame ProfileFrame;
+  struct ProfileFrame
+  {
+    u64 start;
+    u64 elapsed;
+    u64 slot_elapsed[PROFILER_HISTORY_SLOTS];
+    // NOTE(Ryan): Range of snapshotting thread's timeline events that ended within frame
+    u64 event_begin, event_end;
+  };
+
+  typedef struct ProfileSlotStats ProfileSlotStats;
+  struct ProfileSlotStats
+  {
+    u64 min, avg, max, p99;
+  };
+
+  typedef struct ProfileHistory ProfileHistory;
+  struct ProfileHistory
+  {
+    ProfileFrame frames[PROFILER_HISTORY_FRAMES];
+    u64 frame_count;
+    u64 prev_slot_elapsed[PROFILER_HISTORY_SLOTS];
+    u64 prev_start;
+    u64 prev_event_count;
+  };
+
+  typedef struct Profiler Profiler;
+  struct Profiler
+  {
+    ProfileThread *threads;
+    u32 thread_count;
+    u64 start;
+    u64 end;
+
+    u64 walltime_start;
+    u64 cpu_freq;
+    ProfileHistory history;
   };
   
   GLOBAL Profiler global_profiler;
-  GLOBAL u32 global_profiler_parent_slot_index;
+  THREAD_LOCAL ProfileThread *tl_profile_thread;
 
   #define PROFILE_BLOCK(name) \
     for (struct {ProfileEphemeral e; u32 i;} UNIQUE_NAME(l) = {profile_block_start(name, __COUNTER__ + 1, 0), 0}; \
@@ -67,27 +147,60 @@
   #define PROFILE_FUNCTION_BANDWIDTH(byte_count) \
     PROFILE_BANDWIDTH(__func__, byte_count)
   #define PROFILER_END_OF_COMPILATION_UNIT \
-    STATIC_ASSERT(__COUNTER__ <= ARRAY_COUNT(global_profiler.slots));
+    STATIC_ASSERT(__COUNTER__ <= PROFILER_MANUAL_SLOTS);
 
+  // IMPORTANT(Ryan): Never freed, as thread's slots must outlive it for printing
+  INTERNAL ProfileThread *
+  profile_thread_get(void)
+  {
+    if (tl_profile_thread != NULL) return tl_profile_thread;
+
+    ProfileThread *t = (ProfileThread *)calloc(1, sizeof(ProfileThread));
+    u32 thread_i = atomic_u32_fetch_add(&global_profiler.thread_count, 1, MEMORY_ORDER_RELAXED);
+    snprintf(t->name, sizeof(t->name), (thread_i == 0) ? "Main Thread" : "Thread %u", thread_i);
+    t->id = thread_i;
+
+    void * volatile *head = (void * volatile *)&global_profiler.threads;
+    t->next = (ProfileThread *)atomic_ptr_load(head, MEMORY_ORDER_RELAXED);
+    while (!atomic_ptr_cas_weak(head, (void **)&t->next, t, MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED)) {}
+
+    tl_profile_thread = t;
+    return t;
+  }
+
+  // NOTE(Ryan): Called from main thread, so it registers first
   INTERNAL void
   profiler_init(void)
   {
-    global_profiler.start = read_cpu_timer();
+    if (global_profiler.start == 0) 
+    {
+      global_profiler.start = read_cpu_timer();
+      global_profiler.walltime_start = linux_walltime();
+    }
+    profile_thread_get();
   }
   
   INTERNAL ProfileEphemeral
   profile_block_start(const char *label, u32 slot_index, u64 byte_count)
   {
+    ProfileThread *t = profile_thread_get();
+
     ProfileEphemeral ephemeral = ZERO_STRUCT;
-    ephemeral.parent_slot_index = global_profiler_parent_slot_index;
+    ephemeral.parent_slot_index = t->parent_slot_index;
     ephemeral.slot_index = slot_index;
     ephemeral.label = label;
   
-    ProfileSlot *slot = global_profiler.slots + slot_index;
+    ProfileSlot *slot = t->slots + slot_index;
     ephemeral.old_elapsed_children = slot->elapsed_children;
     slot->byte_count += byte_count;
   
-    global_profiler_parent_slot_index = slot_index;
+    t->parent_slot_index = slot_index;
+  #if PROFILER_PERF_COUNTERS
+    // NOTE(Ryan): Opened on first block, as counters only count the thread that opened them
+    if (!t->perf.is_open) linux_perf_counters_open(&t->perf);
+    ephemeral.old_perf = slot->perf;
+    ephemeral.perf_start = linux_perf_counters_read(&t->perf);
+  #endif
     ephemeral.start = read_cpu_timer();
   
     return ephemeral;
@@ -97,10 +210,14 @@
   profile_block_end(ProfileEphemeral *ephemeral)
   {
     u64 elapsed = read_cpu_timer() - ephemeral->start; 
-    global_profiler_parent_slot_index = ephemeral->parent_slot_index;
+    ProfileThread *t = tl_profile_thread;
+  #if PROFILER_PERF_COUNTERS
+    PerfCounterValues perf_end = linux_perf_counters_read(&t->perf);
+  #endif
+    t->parent_slot_index = ephemeral->parent_slot_index;
   
-    ProfileSlot *parent_slot = global_profiler.slots + ephemeral->parent_slot_index;
-    ProfileSlot *slot = global_profiler.slots + ephemeral->slot_index;
+    ProfileSlot *parent_slot = t->slots + ephemeral->parent_slot_index;
+    ProfileSlot *slot = t->slots + ephemeral->slot_index;
 
     parent_slot->elapsed_no_children -= elapsed;
     slot->elapsed_no_children += elapsed;
@@ -108,25 +225,399 @@
     slot->elapsed_children = ephemeral->old_elapsed_children + elapsed; 
     slot->hit_count++;
     slot->label = ephemeral->label;
+  #if PROFILER_PERF_COUNTERS
+    // NOTE(Ryan): Inclusive of children, overwritten like elapsed_children for recursion
+    for (u32 i = 0; i < PERF_COUNTER_COUNT; i += 1)
+    {
+      slot->perf.v[i] = ephemeral->old_perf.v[i] + (perf_end.v[i] - ephemeral->perf_start.v[i]);
+    }
+  #endif
+
+  #if PROFILER_TIMELINE
+    // NOTE(Ryan): One complete event per block, i.e. begin and end in a single entry
+    ProfileEvent *event = t->events + (t->event_count & (PROFILER_MAX_EVENTS - 1));
+    event->label = ephemeral->label;
+    event->start = ephemeral->start;
+    event->elapsed = elapsed;
+    atomic_u64_store_release(&t->event_count, t->event_count + 1);
+  #endif
   
     return 0;
   }
-  
+
+  #if PROFILER_AUTO
+    #include <dlfcn.h>
+    #include <elf.h>
+    #include <cxxabi.h>
+
+  // NOTE(Ryan): Open addressed, so collisions probe onward rather than aliasing another function.
+  // Slot index is derived from table position, so no separate assignment to race on
+  typedef struct ProfileAddress ProfileAddress;
+  struct ProfileAddress
+  {
+    void *addr;
+    // NOTE(Ryan): Filled in at print time; blocks reference this buffer as their label
+    char label[96];
+  };
+  GLOBAL ProfileAddress g_profile_addresses[PROFILER_AUTO_SLOTS];
+
+  INTERNAL u32
+  profile_address_slot(void *addr)
+  {
+    u64 hash = ((u64)addr >> 4) * 11400714819323198485ull;
+    for (u32 probe = 0; probe < PROFILER_AUTO_SLOTS; probe += 1)
+    {
+      u32 i = (u32)(hash + probe) & (PROFILER_AUTO_SLOTS - 1);
+      // NOTE(Ryan): Address is the only thing published, so no ordering needed
+      void * volatile *slot = (void * volatile *)&g_profile_addresses[i].addr;
+      void *existing = atomic_ptr_load(slot, MEMORY_ORDER_RELAXED);
+      if (existing == NULL)
+      {
+        if (atomic_ptr_cas(slot, &existing, addr, MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED))
+        {
+          return PROFILER_MANUAL_SLOTS + i;
+        }
+      }
+      if (existing == addr) return PROFILER_MANUAL_SLOTS + i;
+    }
+
+    // NOTE(Ryan): Table full, so attribute to root which is never printed
+    return 0;
+  }
+
+  // NOTE(Ryan): INTERNAL functions aren't in dynamic symbol table, so fall back to .symtab
+  INTERNAL const char *
+  profiler_elf_find_symbol(String8 elf, u64 addr, u64 base)
+  {
+    if (elf.size < sizeof(Elf64_Ehdr)) return NULL;
+    Elf64_Ehdr *ehdr = (Elf64_Ehdr *)elf.content;
+    if (!MEMORY_MATCH(ehdr->e_ident, ELFMAG, SELFMAG)) return NULL;
+
+    // NOTE(Ryan): Shared objects and PIE have symbols relative to load address
+    u64 offset = (ehdr->e_type == ET_DYN) ? (addr - base) : addr;
+
+    Elf64_Shdr *shdrs = (Elf64_Shdr *)(elf.content + ehdr->e_shoff);
+    for (u32 s = 0; s < ehdr->e_shnum; s += 1)
+    {
+      if (shdrs[s].sh_type != SHT_SYMTAB) continue;
+
+      Elf64_Sym *syms = (Elf64_Sym *)(elf.content + shdrs[s].sh_offset);
+      u64 sym_count = shdrs[s].sh_size / sizeof(Elf64_Sym);
+      char *strtab = (char *)(elf.content + shdrs[shdrs[s].sh_link].sh_offset);
+      for (u64 i = 0; i < sym_count; i += 1)
+      {
+        Elf64_Sym *sym = syms + i;
+        if (ELF64_ST_TYPE(sym->st_info) != STT_FUNC) continue;
+        if (offset >= sym->st_value && offset < sym->st_value + MAX(sym->st_size, 1)) 
+        {
+          return strtab + sym->st_name;
+        }
+      }
+    }
+
+    return NULL;
+  }
+
   INTERNAL void
-  profiler_end_and_print(void)
+  profiler_auto_resolve_labels(void)
   {
-    global_profiler.end = read_cpu_timer();
-    u64 total = global_profiler.end - global_profiler.start;
-    u64 cpu_freq = linux_estimate_cpu_timer_freq();
-    if (cpu_freq)
+    String8 elf = ZERO_STRUCT;
+    char elf_path[256] = ZERO_STRUCT;
+
+    for (u32 i = 0; i < PROFILER_AUTO_SLOTS; i += 1)
     {
-      printf("\nTotal time: %0.4fms (%lu) (CPU freq %lu)\n", 1000.0 * (f64)total/(f64)cpu_freq, total, cpu_freq);
+      ProfileAddress *a = g_profile_addresses + i;
+      if (a->addr == NULL || a->label[0] != '\0') continue;
+
+      const char *name = NULL;
+      Dl_info info = ZERO_STRUCT;
+      if (dladdr(a->addr, &info) != 0)
+      {
+        if (info.dli_sname != NULL && info.dli_saddr == a->addr) name = info.dli_sname;
+        else
+        {
+          const char *path = (info.dli_fname != NULL && info.dli_fname[0] != '\0') ? info.dli_fname : "/proc/self/exe";
+          if (strcmp(path, elf_path) != 0)
+          {
+            if (elf.size != 0) linux_unmap_file(elf);
+            elf = linux_map_entire_file(str8_cstr((char *)path));
+            snprintf(elf_path, sizeof(elf_path), "%s", path);
+          }
+          name = profiler_elf_find_symbol(elf, (u64)a->addr, (u64)info.dli_fbase);
+        }
+      }
+
+      if (name == NULL) 
+      {
+        snprintf(a->label, sizeof(a->label), "%p", a->addr);
+        continue;
+      }
+
+      int status = 0;
+      char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+      snprintf(a->label, sizeof(a->label), "%s", (status == 0) ? demangled : name);
+      free(demangled);
     }
-  
-    for (u32 i = 1; i < ARRAY_COUNT(global_profiler.slots); i += 1)
+
+    if (elf.size != 0) linux_unmap_file(elf);
+  }
+
+  // IMPORTANT(Ryan): Only reloadable code is instrumented, so host never defines these
+  extern "C" __attribute__((no_instrument_function)) void
+  __cyg_profile_func_enter(void *this_fn, void *call_site)
+  {
+    ProfileThread *t = profile_thread_get();
+    if (t->auto_depth < PROFILER_AUTO_MAX_DEPTH)
     {
-      ProfileSlot *slot = global_profiler.slots + i;
-      if (slot->hit_count == 0) break;
+      u32 slot_index = profile_address_slot(this_fn);
+      const char *label = (slot_index != 0) ? g_profile_addresses[slot_index - PROFILER_MANUAL_SLOTS].label : "";
+      t->auto_stack[t->auto_depth] = profile_block_start(label, slot_index, 0);
+    }
+    t->auto_depth += 1;
+  }
+
+  extern "C" __attribute__((no_instrument_function)) void
+  __cyg_profile_func_exit(void *this_fn, void *call_site)
+  {
+    ProfileThread *t = tl_profile_thread;
+    t->auto_depth -= 1;
+    if (t->auto_depth < PROFILER_AUTO_MAX_DEPTH) profile_block_end(&t->auto_stack[t->auto_depth]);
+  }
+  #else
+  INTERNAL void profiler_auto_resolve_labels(void) {}
+  #endif
+
+  // NOTE(Ryan): Called once per frame, before frame's outermost block so its previous run has ended.
+  // Timer frequency is derived from elapsed walltime, rather than blocking like linux_estimate_cpu_timer_freq()
+  INTERNAL void
+  profiler_frame_snapshot(void)
+  {
+    ProfileThread *t = profile_thread_get();
+    ProfileHistory *history = &global_profiler.history;
+    u64 now = read_cpu_timer();
+
+    u64 walltime_elapsed = linux_walltime() - global_profiler.walltime_start;
+    if (walltime_elapsed > 0)
+    {
+      global_profiler.cpu_freq = (u64)((f64)(now - global_profiler.start) * (f64)LINUX_WALLTIME_FREQ / (f64)walltime_elapsed);
+    }
+
+    if (history->prev_start != 0)
+    {
+      ProfileFrame *frame = history->frames + (history->frame_count & (PROFILER_HISTORY_FRAMES - 1));
+      frame->start = history->prev_start;
+      frame->elapsed = now - history->prev_start;
+      for (u32 i = 0; i < PROFILER_HISTORY_SLOTS; i += 1)
+      {
+        frame->slot_elapsed[i] = t->slots[i].elapsed_children - history->prev_slot_elapsed[i];
+      }
+    #if PROFILER_TIMELINE
+      frame->event_begin = history->prev_event_count;
+      frame->event_end = t->event_count;
+    #endif
+      history->frame_count += 1;
+    }
+
+    for (u32 i = 0; i < PROFILER_HISTORY_SLOTS; i += 1)
+    {
+      history->prev_slot_elapsed[i] = t->slots[i].elapsed_children;
+    }
+  #if PROFILER_TIMELINE
+    history->prev_event_count = t->event_count;
+  #endif
+    history->prev_start = now;
+  }
+
+  INTERNAL u32
+  profiler_history_count(void)
+  {
+    return (u32)MIN(global_profiler.history.frame_count, PROFILER_HISTORY_FRAMES);
+  }
+
+  // NOTE(Ryan): 0 is most recent frame
+  INTERNAL ProfileFrame *
+  profiler_history_frame(u32 frames_ago)
+  {
+    ProfileHistory *history = &global_profiler.history;
+    u64 i = history->frame_count - 1 - frames_ago;
+    return history->frames + (i & (PROFILER_HISTORY_FRAMES - 1));
+  }
+
+  INTERNAL int
+  profiler_u64_compare(const void *a, const void *b)
+  {
+    u64 x = *(u64 *)a, y = *(u64 *)b;
+    return (x > y) - (x < y);
+  }
+
+  INTERNAL ProfileSlotStats
+  profiler_slot_stats(u32 slot_index)
+  {
+    ProfileSlotStats result = ZERO_STRUCT;
+    u32 count = profiler_history_count();
+    if (count == 0 || slot_index >= PROFILER_HISTORY_SLOTS) return result;
+
+    u64 values[PROFILER_HISTORY_FRAMES] = ZERO_STRUCT;
+    u64 sum = 0;
+    for (u32 i = 0; i < count; i += 1)
+    {
+      values[i] = profiler_history_frame(i)->slot_elapsed[slot_index];
+      sum += values[i];
+    }
+    qsort(values, count, sizeof(values[0]), profiler_u64_compare);
+
+    result.min = values[0];
+    result.max = values[count - 1];
+    result.avg = sum / count;
+    result.p99 = values[(count * 99) / 100];
+
+    return result;
+  }
+
+  INTERNAL f64
+  profiler_ticks_to_ms(u64 ticks)
+  {
+    if (global_profiler.cpu_freq == 0) return 0.0;
+    return 1000.0 * (f64)ticks / (f64)global_profiler.cpu_freq;
+  }
+
+  // NOTE(Ryan): Events are formatted straight into a magic ring and written out as contiguous views,
+  // so an event straddling the ring's end needs no split or staging copy.
+  // Calling thread only formats; a writer thread drains the ring to file concurrently
+  #define PROFILER_TRACE_RING_SIZE KB(256)
+  #define PROFILER_TRACE_MAX_EVENT_SIZE 512
+
+  typedef struct ProfileTraceWriter ProfileTraceWriter;
+  struct ProfileTraceWriter
+  {
+    RingSPSC ring;
+    FILE *file;
+    thread_handle thread;
+    u32 volatile is_done;
+  };
+
+  INTERNAL b32
+  profiler_trace_flush(ProfileTraceWriter *writer)
+  {
+    String8 view = ring_spsc_peek(&writer->ring);
+    if (view.size != 0)
+    {
+      fwrite(view.content, 1, view.size, writer->file);
+      ring_spsc_consume(&writer->ring, view.size);
+    }
+    return (view.size != 0);
+  }
+
+  INTERNAL void *
+  profiler_trace_writer_thread(void *params)
+  {
+    ProfileTraceWriter *writer = (ProfileTraceWriter *)params;
+    while (true)
+    {
+      // IMPORTANT(Ryan): Load before peeking, so is_done implies every commit is visible
+      b32 is_done = atomic_u32_load_acquire(&writer->is_done);
+      if (!profiler_trace_flush(writer))
+      {
+        if (is_done) break;
+        thread_yield();
+      }
+    }
+    return NULL;
+  }
+
+  INTERNAL void
+  profiler_trace_printf(ProfileTraceWriter *writer, const char *fmt, ...)
+  {
+    u8 *dst = NULL;
+    while ((dst = ring_spsc_reserve(&writer->ring, PROFILER_TRACE_MAX_EVENT_SIZE)) == NULL)
+    {
+      // NOTE(Ryan): Without a writer thread, drain inline
+      if (writer->thread != 0) thread_yield();
+      else profiler_trace_flush(writer);
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    s32 len = vsnprintf((char *)dst, PROFILER_TRACE_MAX_EVENT_SIZE, fmt, args);
+    va_end(args);
+
+    // NOTE(Ryan): Truncated events are kept, as labels are source literals well under the limit
+    if (len > 0) ring_spsc_commit(&writer->ring, MIN((memory_index)len, PROFILER_TRACE_MAX_EVENT_SIZE - 1));
+  }
+
+  // NOTE(Ryan): Chrome trace-event JSON, i.e. open in chrome://tracing or ui.perfetto.dev.
+  // IMPORTANT(Ryan): Events of busy threads may be overwritten while writing, so best called when they're idle
+  INTERNAL void
+  profiler_write_trace(const char *path)
+  {
+  #if PROFILER_TIMELINE
+    u8 *ring_base = mem_magic_ring_allocate(PROFILER_TRACE_RING_SIZE);
+    if (ring_base == NULL)
+    {
+      WARN("Failed to allocate trace ring\n\t%s\n", strerror(errno));
+      return;
+    }
+
+    ProfileTraceWriter writer = ZERO_STRUCT;
+    writer.file = fopen(path, "w");
+    if (writer.file == NULL)
+    {
+      WARN("Failed to open %s\n\t%s\n", path, strerror(errno));
+      mem_magic_ring_release(ring_base, PROFILER_TRACE_RING_SIZE);
+      return;
+    }
+    ring_spsc_init(&writer.ring, ring_base, PROFILER_TRACE_RING_SIZE);
+    writer.thread = start_joinable_thread(profiler_trace_writer_thread, &writer);
+
+    profiler_auto_resolve_labels();
+    // NOTE(Ryan): Estimate blocks for 100ms, so only fallback when no frame snapshot has run yet
+    u64 cpu_freq = global_profiler.cpu_freq;
+    if (cpu_freq == 0) cpu_freq = linux_estimate_cpu_timer_freq();
+    f64 us_per_tick = 1000000.0 / (f64)cpu_freq;
+
+    profiler_trace_printf(&writer, "{\"traceEvents\":[\n");
+    b32 is_first = true;
+    ProfileThread *threads = (ProfileThread *)atomic_ptr_load_acquire((void * volatile *)&global_profiler.threads);
+    for (ProfileThread *t = threads; t != NULL; t = t->next)
+    {
+      profiler_trace_printf(&writer, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                            is_first ? "" : ",\n", t->id, t->name);
+      is_first = false;
+
+      u64 end = atomic_u64_load_acquire(&t->event_count);
+      u64 begin = (end > PROFILER_MAX_EVENTS) ? (end - PROFILER_MAX_EVENTS) : 0;
+      for (u64 i = begin; i < end; i += 1)
+      {
+        ProfileEvent *event = t->events + (i & (PROFILER_MAX_EVENTS - 1));
+        f64 ts = (f64)(event->start - global_profiler.start) * us_per_tick;
+        f64 dur = (f64)event->elapsed * us_per_tick;
+        profiler_trace_printf(&writer, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                              event->label, t->id, ts, dur);
+      }
+    }
+    profiler_trace_printf(&writer, "\n]}\n");
+    if (writer.thread != 0)
+    {
+      atomic_u32_store_release(&writer.is_done, true);
+      thread_join(writer.thread);
+    }
+    else
+    {
+      profiler_trace_flush(&writer);
+    }
+
+    fclose(writer.file);
+    mem_magic_ring_release(ring_base, PROFILER_TRACE_RING_SIZE);
+  #endif
+  }
+
+  INTERNAL void
+  profiler_print_slots(ProfileSlot *slots, u64 total, u64 cpu_freq, b32 perf_is_valid)
+  {
+    for (u32 i = 1; i < PROFILER_MAX_SLOTS; i += 1)
+    {
+      ProfileSlot *slot = slots + i;
+      if (slot->hit_count == 0) continue;
   
       f64 percent = 100.0 * ((f64)slot->elapsed_no_children / (f64)total);
       printf("  %s(%lu): %lu (%0.2f%%", slot->label, slot->hit_count, slot->elapsed_no_children, percent);
@@ -145,9 +636,61 @@
         // TODO(Ryan): gb/s often what striving for? 0.3-0.5gb/s for modern CPUs?
         printf(" %.3fmb at %.2fgb/s", (f64)slot->byte_count / (f64)MB(1), bps / (f64)GB(1));
       }
+    #if PROFILER_PERF_COUNTERS
+      print_perf_counters(&slot->perf, slot->byte_count, perf_is_valid);
+    #endif
       printf("\n");
     }
   }
+  
+  // IMPORTANT(Ryan): Assumes other threads are idle, i.e. their slots aren't being written
+  INTERNAL void
+  profiler_end_and_print(void)
+  {
+    global_profiler.end = read_cpu_timer();
+    u64 total = global_profiler.end - global_profiler.start;
+    u64 cpu_freq = linux_estimate_cpu_timer_freq();
+    if (cpu_freq)
+    {
+      printf("\nTotal time: %0.4fms (%lu) (CPU freq %lu)\n", 1000.0 * (f64)total/(f64)cpu_freq, total, cpu_freq);
+    }
+
+    profiler_auto_resolve_labels();
+    ProfileSlot *totals = (ProfileSlot *)calloc(PROFILER_MAX_SLOTS, sizeof(ProfileSlot));
+    b32 perf_is_valid = false;
+    ProfileThread *threads = (ProfileThread *)atomic_ptr_load_acquire((void * volatile *)&global_profiler.threads);
+    for (ProfileThread *t = threads; t != NULL; t = t->next)
+    {
+      printf("%s:\n", t->name);
+      b32 thread_perf_is_valid = false;
+    #if PROFILER_PERF_COUNTERS
+      thread_perf_is_valid = t->perf.is_valid;
+      perf_is_valid |= thread_perf_is_valid;
+    #endif
+      profiler_print_slots(t->slots, total, cpu_freq, thread_perf_is_valid);
+
+      for (u32 i = 1; i < PROFILER_MAX_SLOTS; i += 1)
+      {
+        ProfileSlot *slot = t->slots + i;
+        if (slot->hit_count == 0) continue;
+        totals[i].elapsed_no_children += slot->elapsed_no_children;
+        totals[i].elapsed_children += slot->elapsed_children;
+        totals[i].hit_count += slot->hit_count;
+        totals[i].byte_count += slot->byte_count;
+        totals[i].label = slot->label;
+      #if PROFILER_PERF_COUNTERS
+        for (u32 j = 0; j < PERF_COUNTER_COUNT; j += 1) totals[i].perf.v[j] += slot->perf.v[j];
+      #endif
+      }
+    }
+
+    if (global_profiler.thread_count > 1)
+    {
+      printf("All threads:\n");
+      profiler_print_slots(totals, total, cpu_freq, perf_is_valid);
+    }
+    free(totals);
+  }
 #else
   #define PROFILER_END_OF_COMPILATION_UNIT
   #define PROFILE_FUNCTION()
@@ -181,6 +724,9 @@
       printf("\nTotal time: %0.4fms (CPU freq %lu)\n", 1000.0 * (f64)total/(f64)cpu_freq, cpu_freq);
     }
   }
+
+  INTERNAL void profiler_write_trace(const char *path) {}
+  INTERNAL void profiler_frame_snapshot(void) {}
 #endif
 
 #endif
@@ -30,10 +30,15 @@ struct RepetitionTester
   u64 max_time;
   u64 total_time;
   u64 test_count;
+
+  LinuxPerfCounters perf;
+  PerfCounterValues perf_accumulated_on_this_test;
+  PerfCounterValues perf_at_min_time;
 };
 
 INTERNAL void
-print_tester_time(RepetitionTester *tester, const char *label, u64 cpu_time, u64 byte_count)
+print_tester_time(RepetitionTester *tester, const char *label, u64 cpu_time, u64 byte_count, 
+                  PerfCounterValues *perf = NULL)
 {
   printf("%s: %.0f", label, (f64)cpu_time);
   f64 seconds = (f64)cpu_time / (f64)tester->cpu_timer_freq;
@@ -44,12 +49,15 @@ print_tester_time(RepetitionTester *tester, const char *label, u64 cpu_time, u64
     f64 best_bandwidth = byte_count / (GB(1) * seconds);
     printf(" %fgb/s", best_bandwidth);
   }
+
+  if (perf != NULL) print_perf_counters(perf, byte_count, tester->perf.is_valid);
 }
 
 INTERNAL void
 print_tester_results(RepetitionTester *tester)
 {
-  print_tester_time(tester, "Min", (f64)tester->min_time, tester->target_bytes_processed);
+  print_tester_time(tester, "Min", (f64)tester->min_time, tester->target_bytes_processed, 
+                    &tester->perf_at_min_time);
   printf("\n");
   
   print_tester_time(tester, "Max", (f64)tester->max_time, tester->target_bytes_processed);
@@ -95,6 +103,9 @@ tester_init_new_wave(RepetitionTester *tester, u64 target_bytes_processed, u64 c
     }
   }
 
+  // NOTE(Ryan): Opened once per tester, so per-thread if each thread owns its tester
+  if (!tester->perf.is_open) linux_perf_counters_open(&tester->perf);
+
   tester->repeat_time = seconds_to_try * cpu_timer_freq;
   tester->start = read_cpu_timer();
 }
@@ -132,11 +143,13 @@ update_tester(RepetitionTester *tester)
         if (elapsed_time < tester->min_time)
         {
           tester->min_time = elapsed_time;
+          tester->perf_at_min_time = tester->perf_accumulated_on_this_test;
 
           // NOTE(Ryan): So, repeat_time begins from most recent minimum
           tester->start = current_time;
 
-          print_tester_time(tester, "New Min", tester->min_time, tester->bytes_accumulated_on_this_test);
+          print_tester_time(tester, "New Min", tester->min_time, tester->bytes_accumulated_on_this_test, 
+                            &tester->perf_at_min_time);
           // printf("               \r");
           // fflush(stdout);
           printf("\n");
@@ -145,6 +158,7 @@ update_tester(RepetitionTester *tester)
         tester->close_block_count = 0;
         tester->time_accumulated_on_this_test = 0;
         tester->bytes_accumulated_on_this_test = 0;
+        tester->perf_accumulated_on_this_test = ZERO_STRUCT;
       }
     }
 
@@ -163,6 +177,8 @@ INTERNAL u32
 begin_test_time(RepetitionTester *tester)
 {
   tester->open_block_count += 1;
+  PerfCounterValues perf = linux_perf_counters_read(&tester->perf);
+  for (u32 i = 0; i < PERF_COUNTER_COUNT; i += 1) tester->perf_accumulated_on_this_test.v[i] -= perf.v[i];
   tester->time_accumulated_on_this_test -= read_cpu_timer();
   return 0;
 }
@@ -172,6 +188,8 @@ end_test_time(RepetitionTester *tester)
 {
   tester->close_block_count += 1;
   tester->time_accumulated_on_this_test += read_cpu_timer();
+  PerfCounterValues perf = linux_perf_counters_read(&tester->perf);
+  for (u32 i = 0; i < PERF_COUNTER_COUNT; i += 1) tester->perf_accumulated_on_this_test.v[i] += perf.v[i];
   return 0;
 }
 
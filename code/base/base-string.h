@@ -643,6 +643,13 @@ ring_read(u8 *ring_base, memory_index ring_size, memory_index pos, void *dst, me
   return read_size;
 }
 
+// IMPORTANT(Ryan): Only for rings from mem_magic_ring_allocate(), as span may run past ring_size
+INTERNAL String8
+ring_read_view(u8 *ring_base, memory_index ring_size, memory_index pos, memory_index read_size)
+{
+  String8 result = str8(ring_base + (pos % ring_size), MIN(read_size, ring_size));
+  return result;
+}
 
 INTERNAL u64
 str8_hash(String8 string)
@@ -650,42 +657,5 @@ str8_hash(String8 string)
   return hash_data(HASH_INIT, string.content, string.size);
 }
 
-#if 0
-INTERNAL void
-ring_queue_thread(u32 val)
-{
- MUTEX_SCOPE(ring_mutex) while (1)
- {
-   if ((ring_write_pos - ring_read_pos) <= ring_size - sizeof(ring_elem))
-   {
-    memory_index write_pos = ring_write_pos;
-    write_pos += RING_WRITE_PTR(ring_base, ring_size, write_pos, &elem);
-    ring_write_pos = write_pos;
-    break;
-   }
-   thread_cv_wait(ring_cv, ring_mutex);
- }
- thread_cv_signal_all(ring_cv);
-}
-
-INTERNAL u32
-ring_dequeue_thread(void)
-{
- u32 elem = 0;
- MUTEX_SCOPE(ring_mutex) while (1)
- {
-   if (ring_write_pos >= ring_read_pos + sizeof(elem))
-   {
-     memory_index read_pos = ring_read_pos;
-     read_pos += RING_READ_PTR(ring_base, ring_size, read_pos, &elem);
-     ring_read_pos = read_pos;
-     break;
-   }
-   thread_cv_wait(ring_cv, ring_mutex);
- }
- thread_cv_signal_all(ring_cv);
- return elem;
-}
-#endif
 
 #endif
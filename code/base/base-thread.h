@@ -5,19 +5,15 @@
 #include <pthread.h>
 #include <sys/types.h>
 
-// TODO(Ryan): put in platform specific
-#define READ_BARRIER asm volatile("" ::: "memory")
-#define WRITE_BARRIER asm volatile("" ::: "memory")
-
 typedef pthread_t thread_handle;
 typedef void* thread_function(void *params);
 INTERNAL thread_handle
-start_thread(thread_function func, void *params)
+__start_thread(thread_function func, void *params, b32 is_detached)
 {
   pthread_attr_t thread_attr = ZERO_STRUCT;
   if (pthread_attr_init(&thread_attr) != 0)
     WARN("Failed to init thread attr.");
-  if (pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED) != 0)
+  if (is_detached && pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED) != 0)
     WARN("Failed to set thread to detached state.");
   // NOTE(Ryan): Set to multiple of common page size 4K
   if (pthread_attr_setstacksize(&thread_attr, KB(4) * 128) != 0)
@@ -30,7 +26,7 @@ start_thread(thread_function func, void *params)
   if (thread_result != 0)
   {
     WARN("Failed to create thread.");
-    return NULL;
+    return 0;
   }
   else
   {
@@ -38,6 +34,20 @@ start_thread(thread_function func, void *params)
   }
 }
 
+INTERNAL thread_handle
+start_thread(thread_function func, void *params)
+{
+  return __start_thread(func, params, true);
+}
+
+// IMPORTANT(Ryan): Must be passed to thread_join(), e.g. threads started from reload code
+// can't outlive the call that started them
+INTERNAL thread_handle
+start_joinable_thread(thread_function func, void *params)
+{
+  return __start_thread(func, params, false);
+}
+
 typedef pthread_mutex_t thread_mutex;
 INTERNAL void
 thread_mutex_init(thread_mutex *mutex)
@@ -110,21 +120,6 @@ thread_set_highpriority(thread_handle thread)
     WARN("Failed to set thread to high priority");
 }
 
-typedef u32 volatile atomic_u32;
-INTERNAL void
-atomic_u32_store(atomic_u32 *a, u32 *v)
-{
-  __atomic_store(a, v, __ATOMIC_SEQ_CST);
-}
-
-INTERNAL u32
-atomic_u32_load(atomic_u32 *a)
-{
-  u32 ret = 0;
-  __atomic_load(a, &ret, __ATOMIC_SEQ_CST);
-  return ret;
-}
-
 typedef pthread_cond_t thread_cv;
 INTERNAL void
 thread_cv_init(thread_cv *cv)
@@ -143,24 +138,235 @@ thread_cv_destroy(thread_cv *cv)
 INTERNAL void
 thread_cv_wait(thread_cv *cv, thread_mutex *mutex)
 {
-  if (pthread_cond_wait(cv, mp) != 0)
+  if (pthread_cond_wait(cv, mutex) != 0)
     WARN("Failed to wait on cv.");
 }
 
 INTERNAL void
 thread_cv_signal(thread_cv *cv)
 {
-  if (pthread_cond_signal(&cv) != 0)
+  if (pthread_cond_signal(cv) != 0)
     WARN("Failed to signal cv");
 }
 
 INTERNAL void
 thread_cv_signal_all(thread_cv *cv)
 {
-  if (pthread_cond_broadcast(&cv) != 0)
+  if (pthread_cond_broadcast(cv) != 0)
     WARN("Failed to broadcast cv");
 }
 
+// NOTE(Ryan): Lock-free byte ring for one producer and one consumer.
+// Positions only increase, so used space is write_pos - read_pos. Each side caches the other's
+// position, only reloading it when the cached value says full/empty.
+// Spans are all-or-nothing, copied with ring_write()/ring_read()
+typedef struct RingSPSC RingSPSC;
+struct RingSPSC
+{
+  u8 *base;
+  memory_index size;
+  u8 pad0[CACHE_LINE_SIZE - sizeof(u8 *) - sizeof(memory_index)];
+
+  memory_index volatile write_pos;
+  memory_index cached_read_pos;
+  u8 pad1[CACHE_LINE_SIZE - 2*sizeof(memory_index)];
+
+  memory_index volatile read_pos;
+  memory_index cached_write_pos;
+  u8 pad2[CACHE_LINE_SIZE - 2*sizeof(memory_index)];
+};
+
+INTERNAL void
+ring_spsc_init(RingSPSC *r, u8 *base, memory_index size)
+{
+  ASSERT(IS_POW2(size));
+  MEMORY_ZERO_STRUCT(r);
+  r->base = base;
+  r->size = size;
+}
+
+INTERNAL b32
+ring_spsc_push(RingSPSC *r, void *src, memory_index size)
+{
+  memory_index w = atomic_u64_load(&r->write_pos, MEMORY_ORDER_RELAXED);
+  if (size > r->size - (w - r->cached_read_pos))
+  {
+    r->cached_read_pos = atomic_u64_load_acquire(&r->read_pos);
+    if (size > r->size - (w - r->cached_read_pos)) return false;
+  }
+
+  ring_write(r->base, r->size, w, src, size);
+  atomic_u64_store_release(&r->write_pos, w + size);
+
+  return true;
+}
+
+INTERNAL b32
+ring_spsc_pop(RingSPSC *r, void *dst, memory_index size)
+{
+  memory_index rd = atomic_u64_load(&r->read_pos, MEMORY_ORDER_RELAXED);
+  if (r->cached_write_pos - rd < size)
+  {
+    r->cached_write_pos = atomic_u64_load_acquire(&r->write_pos);
+    if (r->cached_write_pos - rd < size) return false;
+  }
+
+  ring_read(r->base, r->size, rd, dst, size);
+  atomic_u64_store_release(&r->read_pos, rd + size);
+
+  return true;
+}
+
+// NOTE(Ryan): Zero-copy variants for magic rings, i.e. base from mem_magic_ring_allocate().
+// Producer fills reserved span in place then commits it; consumer parses span in place then consumes it
+INTERNAL u8 *
+ring_spsc_reserve(RingSPSC *r, memory_index size)
+{
+  memory_index w = atomic_u64_load(&r->write_pos, MEMORY_ORDER_RELAXED);
+  if (size > r->size - (w - r->cached_read_pos))
+  {
+    r->cached_read_pos = atomic_u64_load_acquire(&r->read_pos);
+    if (size > r->size - (w - r->cached_read_pos)) return NULL;
+  }
+  return r->base + (w & (r->size - 1));
+}
+
+INTERNAL void
+ring_spsc_commit(RingSPSC *r, memory_index size)
+{
+  memory_index w = atomic_u64_load(&r->write_pos, MEMORY_ORDER_RELAXED);
+  atomic_u64_store_release(&r->write_pos, w + size);
+}
+
+// NOTE(Ryan): Everything available, which may be empty
+INTERNAL String8
+ring_spsc_peek(RingSPSC *r)
+{
+  memory_index rd = atomic_u64_load(&r->read_pos, MEMORY_ORDER_RELAXED);
+  r->cached_write_pos = atomic_u64_load_acquire(&r->write_pos);
+  return ring_read_view(r->base, r->size, rd, r->cached_write_pos - rd);
+}
+
+INTERNAL void
+ring_spsc_consume(RingSPSC *r, memory_index size)
+{
+  memory_index rd = atomic_u64_load(&r->read_pos, MEMORY_ORDER_RELAXED);
+  atomic_u64_store_release(&r->read_pos, rd + size);
+}
+
+#define ring_spsc_push_ptr(r, ptr) ring_spsc_push((r), (ptr), sizeof(*(ptr)))
+#define ring_spsc_pop_ptr(r, ptr) ring_spsc_pop((r), (ptr), sizeof(*(ptr)))
+
+// NOTE(Ryan): Bounded multi-producer/multi-consumer ring of fixed size elements, i.e. Vyukov's queue.
+// Each slot's sequence says whose turn it is: seq == pos means free for producer of pos,
+// seq == pos + 1 means filled for consumer of pos.
+// Sequences are kept apart from elements, so spans of elements copy with ring_write()/ring_read()
+typedef struct RingMPMC RingMPMC;
+struct RingMPMC
+{
+  u64 volatile *seqs;
+  u8 *data;
+  u64 count;
+  u64 elem_size;
+  u8 pad0[CACHE_LINE_SIZE - 2*sizeof(u8 *) - 2*sizeof(u64)];
+
+  u64 volatile write_pos;
+  u8 pad1[CACHE_LINE_SIZE - sizeof(u64)];
+
+  u64 volatile read_pos;
+  u8 pad2[CACHE_LINE_SIZE - sizeof(u64)];
+};
+
+INTERNAL void
+ring_mpmc_init(RingMPMC *r, u64 *seqs, void *data, u64 count, u64 elem_size)
+{
+  ASSERT(IS_POW2(count));
+  MEMORY_ZERO_STRUCT(r);
+  r->seqs = seqs;
+  r->data = (u8 *)data;
+  r->count = count;
+  r->elem_size = elem_size;
+  for (u64 i = 0; i < count; i += 1) r->seqs[i] = i;
+}
+
+// NOTE(Ryan): Returns 0 when slots [pos, pos + n) all have expected sequence offset, 
+// otherwise negative if one is still in use from previous lap or positive if pos is stale
+INTERNAL s64
+ring_mpmc_span_state(RingMPMC *r, u64 pos, u64 n, u64 seq_offset)
+{
+  for (u64 k = 0; k < n; k += 1)
+  {
+    u64 seq = atomic_u64_load_acquire(&r->seqs[(pos + k) & (r->count - 1)]);
+    s64 diff = (s64)(seq - (pos + k + seq_offset));
+    if (diff != 0) return diff;
+  }
+  return 0;
+}
+
+// NOTE(Ryan): All n elements or none
+INTERNAL b32
+ring_mpmc_push(RingMPMC *r, void *src, u64 n)
+{
+  ASSERT(n <= r->count);
+
+  u64 pos = atomic_u64_load(&r->write_pos, MEMORY_ORDER_RELAXED);
+  while (true)
+  {
+    s64 state = ring_mpmc_span_state(r, pos, n, 0);
+    if (state < 0) return false;
+    if (state > 0) 
+    {
+      cpu_pause();
+      pos = atomic_u64_load(&r->write_pos, MEMORY_ORDER_RELAXED);
+    }
+    else if (atomic_u64_cas_weak(&r->write_pos, &pos, pos + n, MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED))
+    {
+      break;
+    }
+  }
+
+  ring_write(r->data, r->count * r->elem_size, pos * r->elem_size, src, n * r->elem_size);
+  for (u64 k = 0; k < n; k += 1)
+  {
+    atomic_u64_store_release(&r->seqs[(pos + k) & (r->count - 1)], pos + k + 1);
+  }
+
+  return true;
+}
+
+INTERNAL b32
+ring_mpmc_pop(RingMPMC *r, void *dst, u64 n)
+{
+  ASSERT(n <= r->count);
+
+  u64 pos = atomic_u64_load(&r->read_pos, MEMORY_ORDER_RELAXED);
+  while (true)
+  {
+    s64 state = ring_mpmc_span_state(r, pos, n, 1);
+    if (state < 0) return false;
+    if (state > 0) 
+    {
+      cpu_pause();
+      pos = atomic_u64_load(&r->read_pos, MEMORY_ORDER_RELAXED);
+    }
+    else if (atomic_u64_cas_weak(&r->read_pos, &pos, pos + n, MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED))
+    {
+      break;
+    }
+  }
+
+  ring_read(r->data, r->count * r->elem_size, pos * r->elem_size, dst, n * r->elem_size);
+  for (u64 k = 0; k < n; k += 1)
+  {
+    atomic_u64_store_release(&r->seqs[(pos + k) & (r->count - 1)], pos + k + r->count);
+  }
+
+  return true;
+}
+
+#define ring_mpmc_push_ptr(r, ptr) ring_mpmc_push((r), (ptr), 1)
+#define ring_mpmc_pop_ptr(r, ptr) ring_mpmc_pop((r), (ptr), 1)
+
 
 // __thread is gcc using linux tls (so tls is OS functionality?)
 
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <string.h>
 
 typedef int8_t s8;
 typedef int16_t  s16;
@@ -119,18 +120,23 @@ typedef size_t memory_index;
 #define F64_GOLD_SMALL 0.618033988749894
 
 // NOTE(Ryan): Taken from https://docs.oracle.com/cd/E19205-01/819-5265/bjbeh/index.html
+// memcpy rather than pointer cast, as the cast breaks strict aliasing and optimiser drops the store
 INTERNAL f32
 f32_inf(void)
 {
   u32 temp = 0x7f800000;
-  return *(f32 *)(&temp);
+  f32 result = 0;
+  memcpy(&result, &temp, sizeof(result));
+  return result;
 }
 
 INTERNAL f32
 f32_neg_inf(void)
 {
   u32 temp = 0xff800000;
-  return *(f32 *)(&temp);
+  f32 result = 0;
+  memcpy(&result, &temp, sizeof(result));
+  return result;
 }
 
 INTERNAL f32
@@ -150,14 +156,18 @@ INTERNAL f64
 f64_inf(void)
 {
   u64 temp = 0x7ff0000000000000;
-  return *(f64 *)(&temp);
+  f64 result = 0;
+  memcpy(&result, &temp, sizeof(result));
+  return result;
 }
 
 INTERNAL f64
 f64_neg_inf(void)
 {
   u64 temp = 0xfff0000000000000;
-  return *(f64 *)(&temp);
+  f64 result = 0;
+  memcpy(&result, &temp, sizeof(result));
+  return result;
 }
 
 
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#include "desktop-assets.h"
+
+// IMPORTANT(Ryan): Included by both host and reloadable code.
+// Workers are started by host so their code isn't unmapped on reload
+
+INTERNAL void
+asset_load_queue_init(AssetLoadQueue *q)
+{
+  ring_mpmc_init(&q->ring, q->seqs, q->loads, ASSETS_LOAD_QUEUE_SIZE, sizeof(AssetLoad));
+  thread_mutex_init(&q->mutex);
+  thread_cv_init(&q->cv);
+}
+
+// NOTE(Ryan): Only locks if a consumer is asleep. 
+// Sleepers are counted under the mutex before rechecking ring, so a wakeup can't be missed.
+// The two SEQ_CST fences (here and in asset_loader_thread()) stop either side's load passing its store
+INTERNAL b32
+asset_load_queue_push(AssetLoadQueue *q, AssetLoad *load)
+{
+  b32 result = ring_mpmc_push_ptr(&q->ring, load);
+
+  atomic_fence(MEMORY_ORDER_SEQ_CST);
+  if (result && atomic_u32_load(&q->sleeping_count, MEMORY_ORDER_RELAXED) > 0)
+  {
+    thread_mutex_lock(&q->mutex);
+    thread_cv_signal(&q->cv);
+    thread_mutex_unlock(&q->mutex);
+  }
+
+  return result;
+}
+
+INTERNAL b32
+asset_load_queue_pop(AssetLoadQueue *q, AssetLoad *load)
+{
+  return ring_mpmc_pop_ptr(&q->ring, load);
+}
+
+// NOTE(Ryan): Only a hint; a non-empty result says nothing about the load being readable yet
+INTERNAL b32
+asset_load_queue_is_empty(AssetLoadQueue *q)
+{
+  u64 read_pos = atomic_u64_load(&q->ring.read_pos, MEMORY_ORDER_RELAXED);
+  u64 write_pos = atomic_u64_load(&q->ring.write_pos, MEMORY_ORDER_RELAXED);
+  return (read_pos == write_pos);
+}
+
+// NOTE(Ryan): CPU-side only, i.e. no GL calls as context is owned by main thread
+INTERNAL void
+asset_load_decode(AssetLoad *load)
+{
+  switch (load->kind)
+  {
+    case ASSET_KIND_SPRITE:
+    {
+      load->image = LoadImage(load->path);
+      if (load->image.data != NULL)
+      {
+        ImageFormat(&load->image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+      }
+    } break;
+    case ASSET_KIND_FONT:
+    {
+      // NOTE(Ryan): Mirrors LoadFontEx() minus the texture upload, with SDF glyphs and skyline packing
+      s32 data_size = 0;
+      u8 *data = LoadFileData(load->path, &data_size);
+      if (data == NULL) break;
+
+      Font *f = &load->font;
+      f->baseSize = ASSETS_FONT_SIZE;
+      f->glyphCount = ASSETS_FONT_GLYPH_COUNT;
+      f->glyphPadding = ASSETS_FONT_GLYPH_PADDING;
+      f->glyphs = LoadFontData(data, data_size, f->baseSize, NULL, f->glyphCount, ASSETS_FONT_TYPE);
+      if (f->glyphs != NULL)
+      {
+        load->image = GenImageFontAtlas(f->glyphs, &f->recs, f->glyphCount, f->baseSize, f->glyphPadding, 1);
+        for (s32 i = 0; i < f->glyphCount; i += 1)
+        {
+          UnloadImage(f->glyphs[i].image);
+          f->glyphs[i].image = ImageFromImage(load->image, f->recs[i]);
+        }
+      }
+
+      UnloadFileData(data);
+    } break;
+    default:
+    {
+      WARN("Unknown asset kind %d for %s\n", load->kind, load->path);
+    } break;
+  }
+}
+
+INTERNAL void *
+asset_loader_thread(void *params)
+{
+  AssetLoader *loader = (AssetLoader *)params;
+
+  while (true)
+  {
+    AssetLoad load = ZERO_STRUCT;
+    if (atomic_u32_load(&loader->is_quitting, MEMORY_ORDER_RELAXED)) break;
+
+    if (!asset_load_queue_pop(&loader->requests, &load))
+    {
+      AssetLoadQueue *q = &loader->requests;
+      thread_mutex_lock(&q->mutex);
+      atomic_u32_fetch_add(&q->sleeping_count, 1, MEMORY_ORDER_RELAXED);
+      atomic_fence(MEMORY_ORDER_SEQ_CST);
+      while (asset_load_queue_is_empty(q) && !atomic_u32_load(&loader->is_quitting, MEMORY_ORDER_RELAXED))
+      {
+        thread_cv_wait(&q->cv, &q->mutex);
+      }
+      atomic_u32_fetch_sub(&q->sleeping_count, 1, MEMORY_ORDER_RELAXED);
+      thread_mutex_unlock(&q->mutex);
+
+      if (atomic_u32_load(&loader->is_quitting, MEMORY_ORDER_RELAXED)) break;
+      continue;
+    }
+
+    asset_load_decode(&load);
+
+    // NOTE(Ryan): Can't fail, as main thread caps loads in flight to queue size
+    asset_load_queue_push(&loader->completions, &load);
+  }
+
+  return NULL;
+}
+
+INTERNAL void
+asset_loader_start(AssetLoader *loader)
+{
+  asset_load_queue_init(&loader->requests);
+  asset_load_queue_init(&loader->completions);
+
+  u32 cores = linux_logical_cores();
+  loader->thread_count = CLAMP(1, cores - 1, ASSETS_LOADER_MAX_THREADS);
+  for (u32 i = 0; i < loader->thread_count; i += 1)
+  {
+    loader->threads[i] = start_thread(asset_loader_thread, loader);
+  }
+}
+
+// NOTE(Ryan): Threads are detached, so just wake them to exit
+INTERNAL void
+asset_loader_stop(AssetLoader *loader)
+{
+  thread_mutex_lock(&loader->requests.mutex);
+  atomic_u32_store(&loader->is_quitting, true, MEMORY_ORDER_RELAXED);
+  thread_mutex_unlock(&loader->requests.mutex);
+  thread_cv_signal_all(&loader->requests.cv);
+}
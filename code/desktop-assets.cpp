@@ -1,7 +1,27 @@
 // SPDX-License-Identifier: zlib-acknowledgement
 #include "desktop-assets.h"
+#include "desktop-assets-loader.cpp"
 
 #define ASSETS_NUM_SLOTS 256
+#define ASSETS_ATLAS_DIM 2048
+#define ASSETS_ATLAS_PADDING 1
+#define ASSETS_UPLOAD_BUDGET_SECONDS 0.002
+
+// NOTE(Ryan): Distance stored in alpha, with 0.5 on glyph edge
+GLOBAL char g_sdf_fragment_shader[] = 
+  "#version 330\n"
+  "in vec2 fragTexCoord;\n"
+  "in vec4 fragColor;\n"
+  "uniform sampler2D texture0;\n"
+  "uniform vec4 colDiffuse;\n"
+  "out vec4 finalColor;\n"
+  "void main()\n"
+  "{\n"
+  "  float dist = texture(texture0, fragTexCoord).a - 0.5;\n"
+  "  float dist_per_fragment = length(vec2(dFdx(dist), dFdy(dist)));\n"
+  "  float alpha = smoothstep(-dist_per_fragment, dist_per_fragment, dist);\n"
+  "  finalColor = vec4(fragColor.rgb, fragColor.a * alpha) * colDiffuse;\n"
+  "}\n";
 
 INTERNAL Texture 
 load_default_texture(void)
@@ -95,86 +115,451 @@ u32 data[IMG_SIZE] = {
 }
 
 
-INTERNAL Font
-assets_get_font(String8 key)
+INTERNAL u32
+assets_pack_find(Assets *assets, String8 key)
 {
   u64 hash = str8_hash(key);
-  u64 slot_i = hash % ASSETS_NUM_SLOTS;
-  FontSlot *slot = g_state->assets.fonts.slots + slot_i;
-  for (FontNode *n = slot->first; n != NULL; n = n->hash_chain_next)
+  for (u32 i = 0; i < assets->pack_entry_count; i += 1)
   {
-    if (str8_match(n->key, key, 0)) return n->value;
+    AssetPackEntry *entry = &assets->pack_entries[i];
+    if (entry->key_hash == hash && str8_match(str8_cstr(entry->key), key, 0)) return i;
   }
-  
-  char cpath[256] = ZERO_STRUCT;
-  str8_to_cstr(key, cpath, sizeof(cpath)); 
+  return U32_MAX;
+}
 
-  // TODO(Ryan): Add parameters to asset keys
-  // NOTE: will get default font if failed, so always valid
-  Font v = LoadFontEx(cpath, 64, NULL, 0);
-  GenTextureMipmaps(&v.texture);
-  SetTextureFilter(v.texture, TEXTURE_FILTER_BILINEAR);
+INTERNAL u64
+assets_modify_time(ASSET_ID id)
+{
+  if (id == ASSET_ID_NIL) return 0;
+  LinuxFileInfo info = linux_file_info(g_state->frame_arena, g_state->assets.keys[id]);
+  return info.modify_time;
+}
+
+// NOTE(Ryan): Source edited since pack was built, e.g. before a cold start, is loaded from file until repacked
+INTERNAL void
+assets_pack_bind(Assets *assets, ASSET_ID id)
+{
+  assets->pack_indices[id] = assets_pack_find(assets, assets->keys[id]);
+  assets->flags[id] &= ~ASSET_FLAG_PACK_STALE;
+  if (assets->pack_indices[id] != U32_MAX && assets_modify_time(id) > assets->pack_modify_time)
+  {
+    assets->flags[id] |= ASSET_FLAG_PACK_STALE;
+  }
+}
+
+// NOTE(Ryan): Key is copied, as literals may live in the reloadable binary
+INTERNAL ASSET_ID
+assets_intern(String8 key)
+{
+  Assets *assets = &g_state->assets;
+
+  u64 hash = str8_hash(key);
+  u64 slot_i = hash % ASSETS_NUM_SLOTS;
+  AssetKeySlot *slot = assets->key_slots + slot_i;
+  for (AssetKeyNode *n = slot->first; n != NULL; n = n->hash_chain_next)
+  {
+    if (str8_match(n->key, key, 0)) return n->id;
+  }
 
-  FontNode *n = MEM_ARENA_PUSH_STRUCT(g_state->assets.arena, FontNode);
-  n->key = key;
-  n->value = v;
+  if (assets->id_count == ASSETS_MAX_IDS)
+  {
+    WARN("Exceeded %d asset ids\n", ASSETS_MAX_IDS);
+    return ASSET_ID_NIL;
+  }
 
+  AssetKeyNode *n = MEM_ARENA_PUSH_STRUCT_ZERO(assets->arena, AssetKeyNode);
+  n->key = str8_copy(assets->arena, key);
+  n->id = assets->id_count++;
   __SLL_QUEUE_PUSH(slot->first, slot->last, n, hash_chain_next);
-  __SLL_STACK_PUSH(g_state->assets.fonts.collection, n, hash_collection_next);
 
-  return v;
+  assets->keys[n->id] = n->key;
+  assets_pack_bind(assets, n->id);
+
+  return n->id;
 }
 
-INTERNAL Texture
-assets_get_texture(String8 key)
+INTERNAL TextureAtlas
+atlas_create(u32 dim)
 {
-  u64 hash = str8_hash(key);
-  u64 slot_i = hash % ASSETS_NUM_SLOTS;
-  TextureSlot *slot = g_state->assets.textures.slots + slot_i;
-  for (TextureNode *n = slot->first; n != NULL; n = n->hash_chain_next)
+  TextureAtlas atlas = ZERO_STRUCT;
+
+  Image img = GenImageColor(dim, dim, BLANK);
+  atlas.texture = LoadTextureFromImage(img);
+  UnloadImage(img);
+
+  return atlas;
+}
+
+// IMPORTANT(Ryan): img must be PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 to match atlas
+INTERNAL b32
+atlas_pack(TextureAtlas *atlas, Image img, Rectangle *src)
+{
+  u32 w = img.width + ASSETS_ATLAS_PADDING;
+  u32 h = img.height + ASSETS_ATLAS_PADDING;
+
+  if (atlas->shelf_x + w > (u32)atlas->texture.width)
   {
-    if (str8_match(n->key, key, 0)) return n->value;
+    atlas->shelf_y += atlas->shelf_h;
+    atlas->shelf_x = 0;
+    atlas->shelf_h = 0;
   }
+  if (w > (u32)atlas->texture.width || atlas->shelf_y + h > (u32)atlas->texture.height) return false;
+
+  Rectangle r = {(f32)atlas->shelf_x, (f32)atlas->shelf_y, (f32)img.width, (f32)img.height};
+  UpdateTextureRec(atlas->texture, r, img.data);
+  *src = r;
+
+  atlas->shelf_x += w;
+  atlas->shelf_h = MAX(atlas->shelf_h, h);
 
-  char cpath[256] = ZERO_STRUCT;
-  str8_to_cstr(key, cpath, sizeof(cpath)); 
+  return true;
+}
+
+INTERNAL Sprite
+assets_default_sprite(void)
+{
+  Texture t = g_state->assets.default_texture;
+  Sprite result = {t, {0, 0, (f32)t.width, (f32)t.height}};
+  return result;
+}
 
-  Texture v = LoadTexture(cpath);
-  if (v.id == 0) 
+INTERNAL b32
+assets_request(ASSET_ID id, ASSET_KIND kind)
+{
+  Assets *assets = &g_state->assets;
+  AssetLoader *loader = &assets->loader;
+  if (loader->in_flight_count == ASSETS_LOAD_QUEUE_SIZE) return false;
+
+  AssetLoad load = ZERO_STRUCT;
+  load.id = id;
+  load.kind = kind;
+  str8_to_cstr(assets->keys[id], load.path, sizeof(load.path)); 
+
+  b32 result = asset_load_queue_push(&loader->requests, &load);
+  if (result) loader->in_flight_count += 1;
+
+  return result;
+}
+
+// IMPORTANT(Ryan): img must be PIXELFORMAT_UNCOMPRESSED_R8G8B8A8; not freed here
+INTERNAL void
+assets_sprite_upload(ASSET_ID id, Image img)
+{
+  Assets *assets = &g_state->assets;
+  Sprite *sprite = &assets->sprites[id];
+
+  b32 was_loaded = HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_SPRITE_LOADED);
+  if (HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_SPRITE_STANDALONE)) UnloadTexture(sprite->texture);
+  assets->flags[id] &= ~ASSET_FLAG_SPRITE_STANDALONE;
+  assets->flags[id] |= ASSET_FLAG_SPRITE_LOADED;
+
+  if (img.data == NULL) 
   {
-    v = g_state->assets.default_texture;
+    *sprite = assets_default_sprite();
+    return;
   }
 
-  TextureNode *n = MEM_ARENA_PUSH_STRUCT(g_state->assets.arena, TextureNode);
-  n->key = key;
-  n->value = v;
+  // NOTE(Ryan): On reload, reuse atlas rect if same size. Otherwise old rect is wasted until restart
+  if (was_loaded && sprite->texture.id == assets->atlas.texture.id && 
+      (s32)sprite->src.width == img.width && (s32)sprite->src.height == img.height)
+  {
+    UpdateTextureRec(assets->atlas.texture, sprite->src, img.data);
+    return;
+  }
 
-  __SLL_QUEUE_PUSH(slot->first, slot->last, n, hash_chain_next);
-  __SLL_STACK_PUSH(g_state->assets.textures.collection, n, hash_collection_next);
+  *sprite = assets_default_sprite();
+  if (atlas_pack(&assets->atlas, img, &sprite->src))
+  {
+    sprite->texture = assets->atlas.texture;
+  }
+  else
+  {
+    WARN("Atlas full, loading %.*s as separate texture\n", str8_varg(assets->keys[id]));
+    sprite->texture = LoadTextureFromImage(img);
+    sprite->src = {0, 0, (f32)img.width, (f32)img.height};
+    assets->flags[id] |= ASSET_FLAG_SPRITE_STANDALONE;
+  }
+}
 
-  return v;
+// NOTE(Ryan): Takes ownership of f.glyphs and f.recs; atlas image not freed here
+INTERNAL void
+assets_font_upload(ASSET_ID id, Font f, Image atlas)
+{
+  Assets *assets = &g_state->assets;
+  if (HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_FONT_LOADED)) UnloadFont(assets->fonts[id]);
+
+  // NOTE(Ryan): No mipmaps, as SDF is resolved per-fragment in sdf_shader
+  f.texture = LoadTextureFromImage(atlas);
+  SetTextureFilter(f.texture, TEXTURE_FILTER_BILINEAR);
+
+  assets->fonts[id] = f;
+  assets->flags[id] |= ASSET_FLAG_FONT_LOADED;
+  assets->font_version += 1;
+}
+
+INTERNAL AssetPackEntry *
+assets_pack_entry(ASSET_ID id)
+{
+  Assets *assets = &g_state->assets;
+  u32 i = assets->pack_indices[id];
+  if (i == U32_MAX || HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_PACK_STALE)) return NULL;
+  return &assets->pack_entries[i];
+}
+
+// NOTE(Ryan): Pixels are pre-decoded, so upload straight from mapping inline
+INTERNAL Image
+assets_pack_image(AssetPackEntry *entry)
+{
+  Image result = ZERO_STRUCT;
+  result.data = g_state->assets.pack.content + entry->pixels_offset;
+  result.width = entry->width;
+  result.height = entry->height;
+  result.mipmaps = 1;
+  result.format = entry->format;
+  return result;
 }
 
 INTERNAL void
-assets_preload(State *state)
+assets_pack_load_font(ASSET_ID id, AssetPackEntry *entry)
+{
+  AssetPackGlyph *pack_glyphs = (AssetPackGlyph *)(g_state->assets.pack.content + entry->glyphs_offset);
+
+  // NOTE(Ryan): Heap allocated as UnloadFont() frees these
+  Font f = ZERO_STRUCT;
+  f.baseSize = entry->base_size;
+  f.glyphCount = entry->glyph_count;
+  f.glyphPadding = entry->glyph_padding;
+  f.glyphs = (GlyphInfo *)MemAlloc(sizeof(GlyphInfo) * (u32)f.glyphCount);
+  f.recs = (Rectangle *)MemAlloc(sizeof(Rectangle) * (u32)f.glyphCount);
+  for (s32 i = 0; i < f.glyphCount; i += 1)
+  {
+    f.glyphs[i].value = pack_glyphs[i].value;
+    f.glyphs[i].offsetX = pack_glyphs[i].offset_x;
+    f.glyphs[i].offsetY = pack_glyphs[i].offset_y;
+    f.glyphs[i].advanceX = pack_glyphs[i].advance_x;
+    f.recs[i] = pack_glyphs[i].rec;
+  }
+
+  assets_font_upload(id, f, assets_pack_image(entry));
+}
+
+// NOTE(Ryan): Returns default until a worker has decoded and assets_update() uploaded it.
+// All sprites sharing the atlas texture lets rlgl batch across them
+INTERNAL Sprite
+assets_sprite(ASSET_ID id)
+{
+  Assets *assets = &g_state->assets;
+  if (id == ASSET_ID_NIL) return assets_default_sprite();
+  if (HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_SPRITE_LOADED | ASSET_FLAG_SPRITE_REQUESTED)) 
+  {
+    return assets->sprites[id];
+  }
+
+  // NOTE(Ryan): Modify time only recorded once loaded or queued, so failed requests don't stat every frame
+  assets->sprites[id] = assets_default_sprite();
+  AssetPackEntry *entry = assets_pack_entry(id);
+  if (entry != NULL && entry->kind == ASSET_KIND_SPRITE)
+  {
+    assets_sprite_upload(id, assets_pack_image(entry));
+    assets->modify_times[id] = assets_modify_time(id);
+    return assets->sprites[id];
+  }
+
+  if (assets_request(id, ASSET_KIND_SPRITE)) 
+  {
+    assets->flags[id] |= ASSET_FLAG_SPRITE_REQUESTED;
+    assets->modify_times[id] = assets_modify_time(id);
+  }
+
+  return assets->sprites[id];
+}
+
+INTERNAL Font
+assets_font(ASSET_ID id)
+{
+  Assets *assets = &g_state->assets;
+  if (id == ASSET_ID_NIL) return GetFontDefault();
+  if (HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_FONT_LOADED)) return assets->fonts[id];
+  if (HAS_FLAGS_ANY(assets->flags[id], ASSET_FLAG_FONT_REQUESTED)) return GetFontDefault();
+
+  AssetPackEntry *entry = assets_pack_entry(id);
+  if (entry != NULL && entry->kind == ASSET_KIND_FONT)
+  {
+    assets_pack_load_font(id, entry);
+    assets->modify_times[id] = assets_modify_time(id);
+    return assets->fonts[id];
+  }
+
+  if (assets_request(id, ASSET_KIND_FONT)) 
+  {
+    assets->flags[id] |= ASSET_FLAG_FONT_REQUESTED;
+    assets->modify_times[id] = assets_modify_time(id);
+  }
+
+  return GetFontDefault();
+}
+
+INTERNAL void
+assets_load_upload(AssetLoad *load)
 {
-  for (FontNode *n = state->assets.fonts.collection; n != NULL; n = n->hash_collection_next)
+  switch (load->kind)
   {
-    UnloadFont(n->value);
+    case ASSET_KIND_SPRITE:
+    {
+      assets_sprite_upload(load->id, load->image);
+    } break;
+    case ASSET_KIND_FONT:
+    {
+      // NOTE(Ryan): Left as requested on failure, so default font keeps being returned
+      if (load->font.glyphs == NULL)
+      {
+        WARN("Failed to load font %s\n", load->path);
+        break;
+      }
+      assets_font_upload(load->id, load->font, load->image);
+    } break;
+    default:
+    {
+      WARN("Unknown asset kind %d for %s\n", load->kind, load->path);
+    } break;
   }
-  for (TextureNode *n = state->assets.textures.collection; n != NULL; n = n->hash_collection_next)
+  UnloadImage(load->image);
+}
+
+INTERNAL void
+assets_update(void)
+{
+  AssetLoader *loader = &g_state->assets.loader;
+
+  f64 start = GetTime();
+  AssetLoad load = ZERO_STRUCT;
+  while (GetTime() - start < ASSETS_UPLOAD_BUDGET_SECONDS && 
+         asset_load_queue_pop(&loader->completions, &load))
   {
-    UnloadTexture(n->value);
+    loader->in_flight_count -= 1;
+    assets_load_upload(&load);
   }
+}
 
-  UnloadTexture(state->assets.default_texture);
-  state->assets.default_texture = load_default_texture();
+// NOTE(Ryan): Convenience for cold paths; hot paths should intern once and keep the id
+INTERNAL Sprite
+assets_get_sprite(String8 key)
+{
+  return assets_sprite(assets_intern(key));
+}
+
+INTERNAL Font
+assets_get_font(String8 key)
+{
+  return assets_font(assets_intern(key));
+}
+
+INTERNAL void
+assets_pack_map(Assets *assets)
+{
+  linux_unmap_file(assets->pack);
+  assets->pack = ZERO_STRUCT;
+  assets->pack_entries = NULL;
+  assets->pack_entry_count = 0;
+  assets->pack_modify_time = 0;
+
+  // NOTE(Ryan): Pack is optional, fallback to loading individual files
+  if (access(ASSET_PACK_PATH, R_OK) != 0) return;
+
+  String8 pack = linux_map_entire_file(str8_lit(ASSET_PACK_PATH));
+  AssetPackHeader *header = (AssetPackHeader *)pack.content;
+  if (pack.size < sizeof(AssetPackHeader) || header->magic != ASSET_PACK_MAGIC || 
+      header->version != ASSET_PACK_VERSION ||
+      header->entries_offset + header->entry_count * sizeof(AssetPackEntry) > pack.size)
+  {
+    WARN("Invalid asset pack %s\n", ASSET_PACK_PATH);
+    linux_unmap_file(pack);
+    return;
+  }
+
+  assets->pack = pack;
+  assets->pack_entries = (AssetPackEntry *)(pack.content + header->entries_offset);
+  assets->pack_entry_count = header->entry_count;
+  assets->pack_modify_time = linux_file_info(g_state->frame_arena, str8_lit(ASSET_PACK_PATH)).modify_time;
+}
+
+// NOTE(Ryan): Old sprite/font remains in use until replacement is uploaded
+INTERNAL b32
+assets_reload(ASSET_ID id)
+{
+  Assets *assets = &g_state->assets;
+  ASSET_FLAG flags = assets->flags[id];
+
+  AssetPackEntry *entry = assets_pack_entry(id);
+  if (HAS_FLAGS_ANY(flags, ASSET_FLAG_SPRITE_LOADED | ASSET_FLAG_SPRITE_REQUESTED))
+  {
+    if (entry != NULL) assets_sprite_upload(id, assets_pack_image(entry));
+    else if (!assets_request(id, ASSET_KIND_SPRITE)) return false;
+  }
+  if (HAS_FLAGS_ANY(flags, ASSET_FLAG_FONT_LOADED | ASSET_FLAG_FONT_REQUESTED))
+  {
+    if (entry != NULL) assets_pack_load_font(id, entry);
+    else if (!assets_request(id, ASSET_KIND_FONT)) return false;
+  }
+
+  return true;
+}
+
+INTERNAL void
+assets_reload_changed(void)
+{
+  Assets *assets = &g_state->assets;
+
+  u64 pack_modify_time = 0;
+  if (access(ASSET_PACK_PATH, R_OK) == 0)
+  {
+    pack_modify_time = linux_file_info(g_state->frame_arena, str8_lit(ASSET_PACK_PATH)).modify_time;
+  }
+  b32 is_pack_changed = (pack_modify_time != assets->pack_modify_time);
+
+  // IMPORTANT(Ryan): Sprites/fonts reference mapping only during upload, so safe to remap
+  if (is_pack_changed)
+  {
+    assets_pack_map(assets);
+    for (ASSET_ID id = 1; id < assets->id_count; id += 1) assets_pack_bind(assets, id);
+  }
+
+  ASSET_FLAG in_use = ASSET_FLAG_SPRITE_LOADED | ASSET_FLAG_SPRITE_REQUESTED | 
+                      ASSET_FLAG_FONT_LOADED | ASSET_FLAG_FONT_REQUESTED;
+  for (ASSET_ID id = 1; id < assets->id_count; id += 1)
+  {
+    if (!HAS_FLAGS_ANY(assets->flags[id], in_use)) continue;
+
+    u64 modify_time = assets_modify_time(id);
+    b32 is_file_changed = (modify_time != assets->modify_times[id]);
+    b32 is_in_pack = (assets->pack_indices[id] != U32_MAX);
+    if (!is_file_changed && !(is_pack_changed && is_in_pack)) continue;
+
+    if (is_file_changed && is_in_pack && !is_pack_changed) assets->flags[id] |= ASSET_FLAG_PACK_STALE;
+    // NOTE(Ryan): If load queue full, time isn't updated so retried next reload
+    if (assets_reload(id)) assets->modify_times[id] = modify_time;
+  }
+}
+
+INTERNAL void
+assets_preload(State *state)
+{
+  Assets *assets = &state->assets;
+  if (assets->is_initialised)
+  {
+    assets_reload_changed();
+    return;
+  }
+  assets->is_initialised = true;
 
-  state->assets.fonts = ZERO_STRUCT;
-  state->assets.textures = ZERO_STRUCT;
+  assets->atlas = atlas_create(ASSETS_ATLAS_DIM);
+  assets->default_texture = load_default_texture();
+  assets->sdf_shader = LoadShaderFromMemory(NULL, g_sdf_fragment_shader);
 
-  mem_arena_clear(state->assets.arena);
+  assets_pack_map(assets);
 
-  state->assets.fonts.slots = MEM_ARENA_PUSH_ARRAY_ZERO(state->assets.arena, FontSlot, ASSETS_NUM_SLOTS);
-  state->assets.textures.slots = MEM_ARENA_PUSH_ARRAY_ZERO(state->assets.arena, TextureSlot, ASSETS_NUM_SLOTS);
+  assets->key_slots = MEM_ARENA_PUSH_ARRAY_ZERO(assets->arena, AssetKeySlot, ASSETS_NUM_SLOTS);
+  assets->id_count = 0;
+  // NOTE(Ryan): Reserve nil id, which always resolves to default
+  assets_intern(str8_lit(""));
 }
@@ -4,55 +4,178 @@
 
 #include <raylib.h>
 
-typedef struct FontNode FontNode;
-struct FontNode
+// NOTE(Ryan): Sub-rect of a texture; Aseprite horizontal sheets are packed whole
+typedef struct Sprite Sprite;
+struct Sprite
 {
-  String8 key;
-  FontNode *hash_chain_next;
-  FontNode *hash_collection_next;
-  Font value;
+  Texture texture;
+  Rectangle src;
+};
+
+// NOTE(Ryan): Paths are interned to dense ids once, so per-draw lookup is an array index
+typedef u32 ASSET_ID;
+#define ASSET_ID_NIL 0
+#define ASSETS_MAX_IDS 1024
+
+typedef u32 ASSET_FLAG;
+enum
+{
+  ASSET_FLAG_SPRITE_LOADED = (1 << 0),
+  ASSET_FLAG_SPRITE_STANDALONE = (1 << 1),
+  ASSET_FLAG_FONT_LOADED = (1 << 2),
+  ASSET_FLAG_SPRITE_REQUESTED = (1 << 3),
+  ASSET_FLAG_FONT_REQUESTED = (1 << 4),
+  // NOTE(Ryan): Source file is newer than pack entry, so load from file
+  ASSET_FLAG_PACK_STALE = (1 << 5),
+};
+
+typedef enum
+{
+  ASSET_KIND_SPRITE,
+  ASSET_KIND_FONT,
+} ASSET_KIND;
+
+// NOTE(Ryan): Fonts are rasterised once as a signed distance field, so any size renders sharply
+#define ASSETS_FONT_SIZE 64
+#define ASSETS_FONT_GLYPH_COUNT 95
+#define ASSETS_FONT_GLYPH_PADDING 0
+#define ASSETS_FONT_TYPE FONT_SDF
+#define ASSETS_LOAD_QUEUE_SIZE 256
+#define ASSETS_LOADER_MAX_THREADS 4
+
+// NOTE(Ryan): Workers fill in decoded CPU data, main thread uploads it
+typedef struct AssetLoad AssetLoad;
+struct AssetLoad
+{
+  ASSET_ID id;
+  ASSET_KIND kind;
+  char path[256];
+
+  Image image;
+  Font font;
 };
-typedef struct FontSlot FontSlot;
-struct FontSlot
+
+// NOTE(Ryan): Lock-free, with mutex and cv only for idle consumers to sleep on
+typedef struct AssetLoadQueue AssetLoadQueue;
+struct AssetLoadQueue
 {
-  FontNode *first;
-  FontNode *last;
+  RingMPMC ring;
+  u64 seqs[ASSETS_LOAD_QUEUE_SIZE];
+  AssetLoad loads[ASSETS_LOAD_QUEUE_SIZE];
+  u32 volatile sleeping_count;
+  thread_mutex mutex;
+  thread_cv cv;
 };
-typedef struct FontMap FontMap;
-struct FontMap
+
+typedef struct AssetLoader AssetLoader;
+struct AssetLoader
 {
-  FontSlot *slots;
-  FontNode *collection;
+  AssetLoadQueue requests;
+  AssetLoadQueue completions;
+  thread_handle threads[ASSETS_LOADER_MAX_THREADS];
+  u32 thread_count;
+  b32 volatile is_quitting;
+
+  // NOTE(Ryan): Main thread only
+  u32 in_flight_count;
 };
 
-typedef struct TextureNode TextureNode;
-struct TextureNode
+typedef struct AssetKeyNode AssetKeyNode;
+struct AssetKeyNode
 {
   String8 key;
-  TextureNode *hash_chain_next;
-  TextureNode *hash_collection_next;
-  Texture value;
+  AssetKeyNode *hash_chain_next;
+  ASSET_ID id;
 };
-typedef struct TextureSlot TextureSlot;
-struct TextureSlot
+typedef struct AssetKeySlot AssetKeySlot;
+struct AssetKeySlot
 {
-  TextureNode *first;
-  TextureNode *last;
+  AssetKeyNode *first;
+  AssetKeyNode *last;
 };
-typedef struct TextureMap TextureMap;
-struct TextureMap
+
+// NOTE(Ryan): Shelf packer, i.e. images placed left to right along a shelf, 
+// starting a new shelf below tallest when full
+typedef struct TextureAtlas TextureAtlas;
+struct TextureAtlas
 {
-  TextureSlot *slots;
-  TextureNode *collection;
+  Texture texture;
+  u32 shelf_x, shelf_y, shelf_h;
+};
+
+// NOTE(Ryan): Written by desktop-pack.cpp with pre-decoded pixels, so runtime just maps and uploads
+#define ASSET_PACK_PATH "build/assets.pack"
+#define ASSET_PACK_MAGIC 0x4b434150 // "PACK"
+#define ASSET_PACK_VERSION 2
+#define ASSET_PACK_ALIGN 16
+
+typedef struct AssetPackHeader AssetPackHeader;
+struct AssetPackHeader
+{
+  u32 magic;
+  u32 version;
+  u32 entry_count;
+  u32 reserved;
+  u64 entries_offset;
+};
+
+typedef struct AssetPackGlyph AssetPackGlyph;
+struct AssetPackGlyph
+{
+  s32 value;
+  s32 offset_x;
+  s32 offset_y;
+  s32 advance_x;
+  Rectangle rec;
+};
+
+typedef struct AssetPackEntry AssetPackEntry;
+struct AssetPackEntry
+{
+  char key[120];
+  u64 key_hash;
+  ASSET_KIND kind;
+  // NOTE(Ryan): raylib PixelFormat
+  s32 format;
+  s32 width, height;
+  u64 pixels_offset, pixels_size;
+  s32 base_size, glyph_padding;
+  s32 glyph_count;
+  u32 reserved;
+  u64 glyphs_offset;
 };
 
 typedef struct Assets Assets;
 struct Assets
 {
+  // NOTE(Ryan): GPU handles and ids don't depend on code, so persist across code reloads
+  b32 is_initialised;
+
   MemArena *arena;
-  FontMap fonts;
-  TextureMap textures;
+  AssetKeySlot *key_slots;
+  u32 id_count;
+
+  String8 keys[ASSETS_MAX_IDS];
+  ASSET_FLAG flags[ASSETS_MAX_IDS];
+  Sprite sprites[ASSETS_MAX_IDS];
+  Font fonts[ASSETS_MAX_IDS];
+  // NOTE(Ryan): Source file time when last loaded, for reloading only changed assets
+  u64 modify_times[ASSETS_MAX_IDS];
+
+  TextureAtlas atlas;
   Texture default_texture;
+  Shader sdf_shader;
+  // NOTE(Ryan): Incremented on font upload, so glyph rect caches know to invalidate
+  u32 font_version;
+
+  AssetLoader loader;
+
+  String8 pack;
+  u64 pack_modify_time;
+  AssetPackEntry *pack_entries;
+  u32 pack_entry_count;
+  // NOTE(Ryan): Resolved when interned, U32_MAX if not in pack
+  u32 pack_indices[ASSETS_MAX_IDS];
 };
 
 #endif
@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+
+// NOTE(Ryan): Repetition tested hot paths, i.e. ./build/desktop-tests-debug bench [--seconds n] [--csv path] [name...]
+// Each run() is one repetition, with only its TIME_TEST() block timed
+
+EXPORT void mov_all_bytes_asm(u8 *data, u32 count);
+
+typedef void *(*benchmark_setup_t)(MemArena *arena, u64 byte_count);
+typedef void (*benchmark_run_t)(RepetitionTester *tester, void *data);
+typedef void (*benchmark_teardown_t)(void *data);
+
+typedef struct Benchmark Benchmark;
+struct Benchmark
+{
+  const char *name;
+  u64 byte_count;
+  benchmark_setup_t setup;
+  benchmark_run_t run;
+  benchmark_teardown_t teardown;
+};
+
+#define BENCHMARK_DEFAULT_SECONDS 3
+#define BENCHMARK_ENTITY_COUNT KB(16)
+#define BENCHMARK_PICK_COUNT KB(4)
+
+typedef struct BenchmarkBuffer BenchmarkBuffer;
+struct BenchmarkBuffer
+{
+  MemArena *arena;
+  u8 *data;
+  u64 size;
+  u8 *ring;
+  u64 ring_size;
+  String8 file_name;
+  u64 checksum;
+};
+
+INTERNAL void *
+benchmark_buffer_setup(MemArena *arena, u64 byte_count)
+{
+  BenchmarkBuffer *b = MEM_ARENA_PUSH_STRUCT_ZERO(arena, BenchmarkBuffer);
+  b->size = byte_count;
+  b->data = MEM_ARENA_PUSH_ARRAY(arena, u8, byte_count);
+  for (u64 i = 0; i < byte_count; i += 1) b->data[i] = (u8)i;
+  return b;
+}
+
+INTERNAL void
+benchmark_mov_all_bytes_asm(RepetitionTester *tester, void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  TIME_TEST(tester)
+  {
+    mov_all_bytes_asm(b->data, (u32)b->size);
+  }
+  tester_count_bytes(tester, b->size);
+}
+
+INTERNAL void
+benchmark_str8_hash(RepetitionTester *tester, void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  TIME_TEST(tester)
+  {
+    b->checksum += str8_hash(str8(b->data, b->size));
+  }
+  tester_count_bytes(tester, b->size);
+}
+
+// NOTE(Ryan): Chaining arena, so includes block allocation on first repetitions
+INTERNAL void *
+benchmark_arena_push_setup(MemArena *arena, u64 byte_count)
+{
+  BenchmarkBuffer *b = MEM_ARENA_PUSH_STRUCT_ZERO(arena, BenchmarkBuffer);
+  b->size = byte_count;
+  b->arena = mem_arena_allocate(byte_count * 2, KB(64));
+  return b;
+}
+
+INTERNAL void
+benchmark_arena_push(RepetitionTester *tester, void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  TIME_TEST(tester)
+  {
+    for (u64 i = 0; i < b->size; i += 64)
+    {
+      MEM_ARENA_PUSH_ARRAY(b->arena, u8, 64);
+    }
+  }
+  tester_count_bytes(tester, b->size);
+  mem_arena_reset(b->arena);
+}
+
+INTERNAL void
+benchmark_arena_teardown(void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  mem_arena_deallocate(b->arena);
+}
+
+// NOTE(Ryan): Odd element size, so writes and reads regularly straddle the wrap
+INTERNAL void *
+benchmark_ring_setup(MemArena *arena, u64 byte_count)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)benchmark_buffer_setup(arena, byte_count);
+  b->ring_size = KB(64);
+  b->ring = MEM_ARENA_PUSH_ARRAY_ZERO(arena, u8, b->ring_size);
+  return b;
+}
+
+INTERNAL void
+benchmark_ring_write_read(RepetitionTester *tester, void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  u8 elem[60] = ZERO_STRUCT;
+  TIME_TEST(tester)
+  {
+    memory_index write_pos = 0, read_pos = 0;
+    for (u64 i = 0; i < b->size; i += sizeof(elem))
+    {
+      memory_index n = MIN(sizeof(elem), b->size - i);
+      write_pos += ring_write(b->ring, b->ring_size, write_pos, b->data + i, n);
+      read_pos += ring_read(b->ring, b->ring_size, read_pos, elem, n);
+    }
+  }
+  tester_count_bytes(tester, b->size);
+  b->checksum += elem[0];
+}
+
+INTERNAL void *
+benchmark_file_read_setup(MemArena *arena, u64 byte_count)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)benchmark_buffer_setup(arena, byte_count);
+  b->arena = mem_arena_allocate(byte_count * 2, MB(1));
+
+  char path[] = "/tmp/desktop-benchmark-XXXXXX";
+  s32 fd = mkstemp(path);
+  if (fd != -1) close(fd);
+  b->file_name = str8_copy(arena, str8_cstr(path));
+  str8_write_entire_file(b->file_name, str8(b->data, b->size));
+
+  return b;
+}
+
+INTERNAL void
+benchmark_file_read(RepetitionTester *tester, void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  String8 file = ZERO_STRUCT;
+  TIME_TEST(tester)
+  {
+    file = str8_read_entire_file(b->arena, b->file_name);
+  }
+  if (file.size != b->size) tester_set_error(tester, "File read size mismatch");
+  tester_count_bytes(tester, file.size);
+  mem_arena_reset(b->arena);
+}
+
+INTERNAL void
+benchmark_file_read_teardown(void *data)
+{
+  BenchmarkBuffer *b = (BenchmarkBuffer *)data;
+  char path[512] = ZERO_STRUCT;
+  str8_to_cstr(b->file_name, path, sizeof(path));
+  unlink(path);
+  mem_arena_deallocate(b->arena);
+}
+
+typedef struct BenchmarkWorld BenchmarkWorld;
+struct BenchmarkWorld
+{
+  SpatialGrid grid;
+  EntityUpdate update;
+  Vector2 *picks;
+  u32 pick_i;
+  Texture default_texture;
+  u64 checksum;
+};
+
+// NOTE(Ryan): Random rocks and trees over a 256x256 tile map, with some dropped items and furnaces
+INTERNAL void *
+benchmark_world_setup(MemArena *arena, u64 byte_count)
+{
+  BenchmarkWorld *w = MEM_ARENA_PUSH_STRUCT_ZERO(arena, BenchmarkWorld);
+
+  // NOTE(Ryan): No window, so camera and default sprite size are as the game would initialise them
+  g_state->camera.zoom = 1.f;
+  w->default_texture = g_state->assets.default_texture;
+  if (g_state->assets.default_texture.width == 0)
+  {
+    g_state->assets.default_texture.width = g_state->assets.default_texture.height = 16;
+  }
+
+  MEMORY_ZERO_STRUCT(&g_state->entities);
+  u32 seed = 1337;
+  for (u32 i = 0; i < BENCHMARK_ENTITY_COUNT; i += 1)
+  {
+    Vector2 p = {f32_rand_range(&seed, 0, 256), f32_rand_range(&seed, 0, 256)};
+    if ((i & 63) == 0) entity_create_building_furnace(p);
+    else if ((i & 7) == 0) entity_create_item_pinewood(p);
+    else if (i & 1) entity_create_rock(p);
+    else entity_create_tree(p);
+  }
+
+  entity_update_prepare(&w->update, 8.f);
+  w->grid = spatial_grid_create(arena, HITBOX_GRID_SLOT_COUNT, TILE_WIDTH, BENCHMARK_ENTITY_COUNT);
+  entity_hitbox_grid_build(&w->grid, &w->update);
+
+  w->picks = MEM_ARENA_PUSH_ARRAY(arena, Vector2, BENCHMARK_PICK_COUNT);
+  for (u32 i = 0; i < BENCHMARK_PICK_COUNT; i += 1)
+  {
+    w->picks[i] = tile_to_world_pos({f32_rand_range(&seed, 0, 256), f32_rand_range(&seed, 0, 256)});
+  }
+
+  return w;
+}
+
+INTERNAL void
+benchmark_world_teardown(void *data)
+{
+  BenchmarkWorld *w = (BenchmarkWorld *)data;
+  MEMORY_ZERO_STRUCT(&g_state->entities);
+  g_state->assets.default_texture = w->default_texture;
+  spatial_grid_release(&w->grid);
+}
+
+INTERNAL void
+benchmark_hitbox_grid_build(RepetitionTester *tester, void *data)
+{
+  BenchmarkWorld *w = (BenchmarkWorld *)data;
+  TIME_TEST(tester)
+  {
+    spatial_grid_clear(&w->grid);
+    entity_hitbox_grid_build(&w->grid, &w->update);
+    w->checksum += w->grid.hitbox_count;
+  }
+  tester_count_bytes(tester, g_state->entities.count * (sizeof(Vector2) + sizeof(u32)));
+}
+
+// NOTE(Ryan): One frame's entity passes as code_update() runs them, with player at a different spot each frame.
+// Pickups slowly thin out items, so early repetitions do marginally more work
+INTERNAL void
+benchmark_entity_update(RepetitionTester *tester, void *data)
+{
+  BenchmarkWorld *w = (BenchmarkWorld *)data;
+  Vector2 player_world = w->picks[w->pick_i++ & (BENCHMARK_PICK_COUNT - 1)];
+  TIME_TEST(tester)
+  {
+    spatial_grid_clear(&w->grid);
+    entity_hitbox_grid_build(&w->grid, &w->update);
+    entity_pickup(&w->grid, player_world);
+    entity_crafting_update(&w->update);
+    w->checksum += w->grid.hitbox_count;
+  }
+  // NOTE(Ryan): Nominal, as pickups shrink entity count
+  tester_count_bytes(tester, BENCHMARK_ENTITY_COUNT * (sizeof(Vector2) + sizeof(u32)));
+}
+
+INTERNAL void
+benchmark_hitbox_pick(RepetitionTester *tester, void *data)
+{
+  BenchmarkWorld *w = (BenchmarkWorld *)data;
+  TIME_TEST(tester)
+  {
+    for (u32 i = 0; i < BENCHMARK_PICK_COUNT; i += 1)
+    {
+      w->checksum += entity_pick(&w->grid, w->picks[i], NULL).gen;
+    }
+  }
+}
+
+GLOBAL Benchmark g_benchmarks[] = {
+  {"mov_all_bytes_asm", MB(1), benchmark_buffer_setup, benchmark_mov_all_bytes_asm, NULL},
+  {"str8_hash", MB(1), benchmark_buffer_setup, benchmark_str8_hash, NULL},
+  {"arena_push", MB(16), benchmark_arena_push_setup, benchmark_arena_push, benchmark_arena_teardown},
+  {"ring_write_read", MB(1), benchmark_ring_setup, benchmark_ring_write_read, NULL},
+  {"file_read", MB(16), benchmark_file_read_setup, benchmark_file_read, benchmark_file_read_teardown},
+  {"hitbox_grid_build", BENCHMARK_ENTITY_COUNT * (sizeof(Vector2) + sizeof(u32)),
+   benchmark_world_setup, benchmark_hitbox_grid_build, benchmark_world_teardown},
+  {"entity_update", BENCHMARK_ENTITY_COUNT * (sizeof(Vector2) + sizeof(u32)),
+   benchmark_world_setup, benchmark_entity_update, benchmark_world_teardown},
+  {"hitbox_pick", 0, benchmark_world_setup, benchmark_hitbox_pick, benchmark_world_teardown},
+};
+
+INTERNAL b32
+benchmark_is_selected(Benchmark *b, char **names, u32 name_count)
+{
+  if (name_count == 0) return true;
+  for (u32 i = 0; i < name_count; i += 1)
+  {
+    if (strcmp(names[i], b->name) == 0) return true;
+  }
+  return false;
+}
+
+// NOTE(Ryan): One CSV row per benchmark, using its best repetition
+INTERNAL void
+benchmark_write_csv_row(FILE *csv, Benchmark *b, RepetitionTester *tester)
+{
+  f64 freq = (f64)tester->cpu_timer_freq;
+  f64 min_seconds = (f64)tester->min_time / freq;
+  f64 gbps = (b->byte_count != 0 && min_seconds > 0.0) ? (f64)b->byte_count / (GB(1) * min_seconds) : 0.0;
+  f64 avg = (tester->test_count != 0) ? (f64)tester->total_time / (f64)tester->test_count : 0.0;
+
+  PerfCounterValues *perf = &tester->perf_at_min_time;
+  fprintf(csv, "%s,%lu,%lu,%lu,%f,%f,%f,%f,%d,%lu,%lu,%lu,%lu,%lu\n", b->name, b->byte_count, tester->test_count,
+          tester->min_time, 1000.0 * min_seconds, 1000.0 * avg / freq, 1000.0 * (f64)tester->max_time / freq,
+          gbps, tester->perf.is_valid, perf->v[PERF_COUNTER_CYCLES], perf->v[PERF_COUNTER_INSTRUCTIONS],
+          perf->v[PERF_COUNTER_CACHE_MISSES], perf->v[PERF_COUNTER_BRANCH_MISSES], perf->v[PERF_COUNTER_PAGE_FAULTS]);
+}
+
+INTERNAL int
+benchmarks_run(int argc, char *argv[])
+{
+  u32 seconds = BENCHMARK_DEFAULT_SECONDS;
+  const char *csv_path = NULL;
+  char **names = MEM_ARENA_PUSH_ARRAY(g_state->arena, char *, (u32)argc + 1);
+  u32 name_count = 0;
+  for (s32 i = 0; i < argc; i += 1)
+  {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = (u32)atoi(argv[++i]);
+    else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csv_path = argv[++i];
+    else if (strcmp(argv[i], "--list") == 0)
+    {
+      for (u32 b = 0; b < ARRAY_COUNT(g_benchmarks); b += 1) printf("%s\n", g_benchmarks[b].name);
+      return 0;
+    }
+    else names[name_count++] = argv[i];
+  }
+
+  FILE *csv = stdout;
+  if (csv_path != NULL)
+  {
+    csv = fopen(csv_path, "w");
+    if (csv == NULL)
+    {
+      WARN("Failed to open %s\n\t%s\n", csv_path, strerror(errno));
+      return 1;
+    }
+  }
+
+  u64 cpu_timer_freq = linux_estimate_cpu_timer_freq();
+  int result = 0;
+  RepetitionTester testers[ARRAY_COUNT(g_benchmarks)] = ZERO_STRUCT;
+  for (u32 i = 0; i < ARRAY_COUNT(g_benchmarks); i += 1)
+  {
+    Benchmark *b = &g_benchmarks[i];
+    if (!benchmark_is_selected(b, names, name_count)) continue;
+
+    printf("\n--- %s ---\n", b->name);
+    MemArenaTemp temp = mem_arena_temp_begin(NULL, 0);
+    void *data = b->setup(temp.arena, b->byte_count);
+
+    RepetitionTester *tester = &testers[i];
+    tester_init_new_wave(tester, b->byte_count, cpu_timer_freq, seconds);
+    while (update_tester(tester)) b->run(tester, data);
+    linux_perf_counters_close(&tester->perf);
+
+    if (b->teardown != NULL) b->teardown(data);
+    mem_arena_temp_end(temp);
+
+    if (tester->state == TESTER_STATE_ERROR) result = 1;
+  }
+
+  // NOTE(Ryan): After all human readable output, so CSV is contiguous when sharing stdout
+  if (csv == stdout) printf("\n");
+  fprintf(csv, "name,bytes,repetitions,min_cycles,min_ms,avg_ms,max_ms,min_gbps,"
+               "perf_valid,cycles,instructions,cache_misses,branch_misses,page_faults\n");
+  for (u32 i = 0; i < ARRAY_COUNT(g_benchmarks); i += 1)
+  {
+    if (testers[i].state != TESTER_STATE_COMPLETED) continue;
+    benchmark_write_csv_row(csv, &g_benchmarks[i], &testers[i]);
+  }
+
+  if (csv != stdout) fclose(csv);
+
+  return result;
+}
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+
+// NOTE(Ryan): Offline asset packer, i.e. ./build pack
+// Decodes assets/*.png and assets/*.ttf once, writing raw pixels and glyph tables to ASSET_PACK_PATH
+
+#include "desktop.h"
+
+// NOTE(Ryan): is_ok is sticky, so only the first failure is reported and later writes are skipped
+INTERNAL u64
+pack_write(FILE *file, u64 offset, void *data, u64 size, b32 *is_ok)
+{
+  u64 aligned = ALIGN_POW2_UP(offset, ASSET_PACK_ALIGN);
+  if (!*is_ok) return aligned;
+
+  if (fseek(file, (long)aligned, SEEK_SET) != 0)
+  {
+    WARN("Failed to seek to %" PRIu64 " in %s\n\t%s\n", aligned, ASSET_PACK_PATH, strerror(errno));
+    *is_ok = false;
+  }
+  else if (fwrite(data, 1, size, file) != size)
+  {
+    WARN("Failed to write %" PRIu64 " bytes to %s\n\t%s\n", size, ASSET_PACK_PATH, strerror(errno));
+    *is_ok = false;
+  }
+
+  return aligned;
+}
+
+INTERNAL void
+pack_entry_key(AssetPackEntry *entry, char *path)
+{
+  String8 key = str8_cstr(path);
+  str8_to_cstr(key, entry->key, sizeof(entry->key));
+  entry->key_hash = str8_hash(key);
+}
+
+int
+main(int argc, char *argv[])
+{
+  global_debugger_present = linux_was_launched_by_gdb();
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  FilePathList files = LoadDirectoryFilesEx("assets", ".png;.ttf", false);
+  AssetPackEntry *entries = (AssetPackEntry *)calloc(files.count, sizeof(AssetPackEntry));
+  u32 entry_count = 0;
+
+  FILE *file = fopen(ASSET_PACK_PATH, "wb");
+  if (file == NULL)
+  {
+    WARN("Failed to open %s\n\t%s\n", ASSET_PACK_PATH, strerror(errno));
+    return 1;
+  }
+
+  b32 is_ok = true;
+  AssetPackHeader header = ZERO_STRUCT;
+  u64 offset = pack_write(file, 0, &header, sizeof(header), &is_ok) + sizeof(header);
+
+  for (u32 i = 0; i < files.count && is_ok; i += 1)
+  {
+    char *path = files.paths[i];
+    AssetPackEntry *entry = &entries[entry_count];
+
+    if (IsFileExtension(path, ".png"))
+    {
+      Image img = LoadImage(path);
+      if (img.data == NULL) continue;
+      ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+      pack_entry_key(entry, path);
+      entry->kind = ASSET_KIND_SPRITE;
+      entry->format = img.format;
+      entry->width = img.width;
+      entry->height = img.height;
+      entry->pixels_size = (u64)GetPixelDataSize(img.width, img.height, img.format);
+      entry->pixels_offset = pack_write(file, offset, img.data, entry->pixels_size, &is_ok);
+      offset = entry->pixels_offset + entry->pixels_size;
+
+      UnloadImage(img);
+    }
+    else
+    {
+      // NOTE(Ryan): Same parameters as runtime font loading
+      s32 data_size = 0;
+      u8 *data = LoadFileData(path, &data_size);
+      if (data == NULL) continue;
+
+      s32 glyph_count = ASSETS_FONT_GLYPH_COUNT, glyph_padding = ASSETS_FONT_GLYPH_PADDING;
+      GlyphInfo *glyphs = LoadFontData(data, data_size, ASSETS_FONT_SIZE, NULL, glyph_count, ASSETS_FONT_TYPE);
+      UnloadFileData(data);
+      if (glyphs == NULL) continue;
+
+      Rectangle *recs = NULL;
+      Image atlas = GenImageFontAtlas(glyphs, &recs, glyph_count, ASSETS_FONT_SIZE, glyph_padding, 1);
+
+      pack_entry_key(entry, path);
+      entry->kind = ASSET_KIND_FONT;
+      entry->format = atlas.format;
+      entry->width = atlas.width;
+      entry->height = atlas.height;
+      entry->pixels_size = (u64)GetPixelDataSize(atlas.width, atlas.height, atlas.format);
+      entry->pixels_offset = pack_write(file, offset, atlas.data, entry->pixels_size, &is_ok);
+      offset = entry->pixels_offset + entry->pixels_size;
+
+      AssetPackGlyph *pack_glyphs = (AssetPackGlyph *)calloc((u32)glyph_count, sizeof(AssetPackGlyph));
+      for (s32 g = 0; g < glyph_count; g += 1)
+      {
+        pack_glyphs[g].value = glyphs[g].value;
+        pack_glyphs[g].offset_x = glyphs[g].offsetX;
+        pack_glyphs[g].offset_y = glyphs[g].offsetY;
+        pack_glyphs[g].advance_x = glyphs[g].advanceX;
+        pack_glyphs[g].rec = recs[g];
+      }
+      entry->base_size = ASSETS_FONT_SIZE;
+      entry->glyph_padding = glyph_padding;
+      entry->glyph_count = glyph_count;
+      u64 glyphs_size = sizeof(AssetPackGlyph) * (u32)glyph_count;
+      entry->glyphs_offset = pack_write(file, offset, pack_glyphs, glyphs_size, &is_ok);
+      offset = entry->glyphs_offset + glyphs_size;
+
+      free(pack_glyphs);
+      MemFree(recs);
+      UnloadImage(atlas);
+      UnloadFontData(glyphs, glyph_count);
+    }
+
+    printf("Packed %s\n", path);
+    entry_count += 1;
+  }
+
+  header.magic = ASSET_PACK_MAGIC;
+  header.version = ASSET_PACK_VERSION;
+  header.entry_count = entry_count;
+  header.entries_offset = pack_write(file, offset, entries, sizeof(AssetPackEntry) * entry_count, &is_ok);
+  pack_write(file, 0, &header, sizeof(header), &is_ok);
+
+  if (fclose(file) != 0 && is_ok)
+  {
+    WARN("Failed to close %s\n\t%s\n", ASSET_PACK_PATH, strerror(errno));
+    is_ok = false;
+  }
+  free(entries);
+  UnloadDirectoryFiles(files);
+
+  // IMPORTANT(Ryan): Loader would still mmap a truncated pack, so don't leave one behind
+  if (!is_ok)
+  {
+    unlink(ASSET_PACK_PATH);
+    return 1;
+  }
+
+  return 0;
+}
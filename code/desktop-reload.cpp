@@ -8,6 +8,8 @@
 State *g_state = NULL;
 
 #include "desktop-assets.cpp"
+#include "desktop-spatial.cpp"
+#include "desktop-text.cpp"
 
 // TODO: merge these into an introspected struct for UI tweaking
 // :tweaks
@@ -17,16 +19,65 @@ State *g_state = NULL;
 #define ROCK_HEALTH 3
 #define TREE_HEALTH 3
 #define PLAYER_PICKUP_RADIUS 40
+#define HITBOX_GRID_SLOT_COUNT 4096
 #define TOOLTIP_BOX_COLOUR
 #define UI_Z_LAYER 50
 #define WORLD_Z_LAYER 20
 
+INTERNAL String8
+get_texture_path_from_entity_type(ENTITY_TYPE type)
+{
+  String8 texture_string = ZERO_STRUCT;
+  switch (type)
+  {
+    default:
+    {
+      TraceLog(LOG_WARNING, "Failed to get texture");
+    } break;
+    case ENTITY_TYPE_NIL: break;
+    case ENTITY_TYPE_PLAYER:
+    {
+      texture_string = str8_lit("assets/player.png");
+    } break;
+    case ENTITY_TYPE_ROCK:
+    {
+      texture_string = str8_lit("assets/rock.png");
+    } break;
+    case ENTITY_TYPE_TREE:
+    {
+      texture_string = str8_lit("assets/tree.png");
+    } break;
+    case ENTITY_TYPE_ITEM_PINEWOOD:
+    {
+      texture_string = str8_lit("assets/item-pinewood.png");
+    } break;
+    case ENTITY_TYPE_BUILDING_FURNACE:
+    {
+      texture_string = str8_lit("assets/building-furnace.png");
+    } break;
+    case ENTITY_TYPE_BUILDING_WORKBENCH:
+    {
+      texture_string = str8_lit("assets/building-workbench.png");
+    } break;
+  }
+  return texture_string;
+}
+
 EXPORT void 
 code_preload(State *state)
 {
+  g_state = state;
   profiler_init();
   
   assets_preload(state);
+
+  // NOTE(Ryan): Interning is idempotent, so ids are unchanged across reloads
+  for (u32 t = 0; t < ENTITY_TYPE_COUNT; t += 1)
+  {
+    String8 path = get_texture_path_from_entity_type((ENTITY_TYPE)t);
+    state->entity_sprite_ids[t] = (path.size > 0) ? assets_intern(path) : ASSET_ID_NIL;
+  }
+  state->ui_font_id = assets_intern(str8_lit("assets/Alegreya-Regular.ttf"));
 }
 
 EXPORT void 
@@ -77,69 +128,208 @@ tile_to_world_pos(Vector2 tile)
 
 
 
-INTERNAL Entity *
-entity_alloc(void)
+INTERNAL void
+entity_move(Entities *es, u32 dst, u32 src)
+{
+  es->pos[dst] = es->pos[src];
+  es->type[dst] = es->type[src];
+  es->health[dst] = es->health[src];
+  es->slot[dst] = es->slot[src];
+  es->slots[es->slot[dst]].dense = dst;
+}
+
+// NOTE(Ryan): Reuse freed slots first, otherwise take a never used slot from the end.
+// To keep type ranges contiguous, open a hole at end of type's range by moving 
+// the first entity of each following range to its end. So, O(ENTITY_TYPE_COUNT)
+INTERNAL Handle
+entity_alloc(ENTITY_TYPE type)
 {
-  for (u32 i = 0; i < ARRAY_COUNT(g_state->entities); i += 1)
+  Entities *es = &g_state->entities;
+
+  EntitySlot *slot = es->free_list;
+  if (slot != NULL)
   {
-    Entity *e = &g_state->entities[i];
-    if (!e->is_active)
-    {
-      e->is_active = true;
-      return e;
-    }
+    __SLL_STACK_POP(es->free_list, next_free);
   }
+  else if (es->slot_count < ARRAY_COUNT(es->slots))
+  {
+    slot = &es->slots[es->slot_count++];
+  }
+  else
+  {
+    WARN("Entity limit of %d reached\n", MAX_ENTITIES);
+    return zero_handle_create();
+  }
+
+  u32 hole = es->count;
+  for (u32 t = ENTITY_TYPE_COUNT - 1; t > type; t -= 1)
+  {
+    u32 first = es->type_first[t];
+    if (first != hole) entity_move(es, hole, first);
+    es->type_first[t] = first + 1;
+    hole = first;
+  }
+  es->type_first[ENTITY_TYPE_COUNT] += 1;
+  es->count += 1;
+
+  u32 slot_i = (u32)(slot - es->slots);
+  es->pos[hole] = ZERO_STRUCT;
+  es->type[hole] = type;
+  es->health[hole] = 0;
+  es->slot[hole] = slot_i;
+  es->flags[slot_i] = 0;
+  es->crafting[slot_i] = ZERO_STRUCT;
+
+  slot->next_free = NULL;
+  slot->dense = hole;
+  slot->is_active = true;
+
+  return TO_HANDLE(slot);
+}
 
+INTERNAL EntitySlot *
+entity_slot_from_handle(Handle h)
+{
+  EntitySlot *slot = (EntitySlot *)h.addr;
+  if (slot != NULL && slot->gen == h.gen) return slot;
   return NULL;
 }
 
+INTERNAL u32
+entity_index(Handle h)
+{
+  EntitySlot *slot = entity_slot_from_handle(h);
+  if (slot == NULL) return ENTITY_INDEX_NIL;
+  return slot->dense;
+}
+
+// NOTE(Ryan): Mirror of entity_alloc(); fill the hole with the last entity of the same type, 
+// then shift each following range down by moving its last entity into the hole before it
 INTERNAL void
-entity_free(Entity *e)
+entity_free(Handle h)
+{
+  Entities *es = &g_state->entities;
+
+  EntitySlot *slot = entity_slot_from_handle(h);
+  if (slot == NULL) return;
+
+  u32 i = slot->dense;
+  ENTITY_TYPE type = es->type[i];
+
+  u32 hole = es->type_first[type + 1] - 1;
+  if (i != hole) entity_move(es, i, hole);
+  for (u32 t = type + 1; t < ENTITY_TYPE_COUNT; t += 1)
+  {
+    u32 last = es->type_first[t + 1] - 1;
+    if (last != hole) entity_move(es, hole, last);
+    es->type_first[t] -= 1;
+    hole = last;
+  }
+  es->type_first[ENTITY_TYPE_COUNT] -= 1;
+  es->count -= 1;
+
+  // IMPORTANT(Ryan): Bumping generation invalidates all outstanding handles
+  slot->gen += 1;
+  slot->dense = ENTITY_INDEX_NIL;
+  slot->is_active = false;
+  __SLL_STACK_PUSH(es->free_list, slot, next_free);
+}
+
+INTERNAL Handle
+entity_create_player(Vector2 pos)
 {
-  MEMORY_ZERO(e, sizeof(Entity));
+  Handle h = entity_alloc(ENTITY_TYPE_PLAYER);
+  u32 i = entity_index(h);
+  if (i != ENTITY_INDEX_NIL) g_state->entities.pos[i] = pos;
+  return h;
 }
 
-INTERNAL Entity *
-entity_create_player(void)
+INTERNAL Handle
+entity_create_rock(Vector2 pos)
 {
-  Entity *e = entity_alloc();
-  e->type = ENTITY_TYPE_PLAYER;
-  return e;
+  Handle h = entity_alloc(ENTITY_TYPE_ROCK);
+  u32 i = entity_index(h);
+  if (i != ENTITY_INDEX_NIL)
+  {
+    g_state->entities.pos[i] = pos;
+    g_state->entities.health[i] = ROCK_HEALTH;
+  }
+  return h;
 }
 
-INTERNAL Entity *
-entity_create_rock(void)
+INTERNAL Handle
+entity_create_tree(Vector2 pos)
 {
-  Entity *e = entity_alloc();
-  e->type = ENTITY_TYPE_ROCK;
-  e->health = ROCK_HEALTH;
-  return e;
+  Handle h = entity_alloc(ENTITY_TYPE_TREE);
+  u32 i = entity_index(h);
+  if (i != ENTITY_INDEX_NIL)
+  {
+    g_state->entities.pos[i] = pos;
+    g_state->entities.health[i] = TREE_HEALTH;
+  }
+  return h;
 }
 
-INTERNAL Entity *
-entity_create_tree(void)
+INTERNAL Handle
+entity_create_item_pinewood(Vector2 pos)
 {
-  Entity *e = entity_alloc();
-  e->type = ENTITY_TYPE_TREE;
-  e->health = TREE_HEALTH;
-  return e;
+  Handle h = entity_alloc(ENTITY_TYPE_ITEM_PINEWOOD);
+  u32 i = entity_index(h);
+  if (i != ENTITY_INDEX_NIL) g_state->entities.pos[i] = pos;
+  return h;
 }
 
-INTERNAL Entity *
-entity_create_item_pinewood(void)
+INTERNAL Handle
+entity_create_building_furnace(Vector2 pos)
 {
-  Entity *e = entity_alloc();
-  e->type = ENTITY_TYPE_ITEM_PINEWOOD;
-  e->is_item = true;
-  return e;
+  Handle h = entity_alloc(ENTITY_TYPE_BUILDING_FURNACE);
+  u32 i = entity_index(h);
+  if (i != ENTITY_INDEX_NIL) g_state->entities.pos[i] = pos;
+  return h;
 }
 
-INTERNAL Entity *
-entity_create_building_furnace(void)
+INTERNAL b32
+entity_type_is_item(ENTITY_TYPE type)
 {
-  Entity *e = entity_alloc();
-  e->type = ENTITY_TYPE_BUILDING_FURNACE;
-  return e;
+  return (type >= ENTITY_TYPE_ITEM_FIRST && type <= ENTITY_TYPE_ITEM_LAST);
+}
+
+// NOTE(Ryan): Counting sort on type keeps per-type draw order and texture switches as before
+INTERNAL VisibleEntities
+entity_cull(MemArena *arena, SpatialGrid *grid, Rectangle view)
+{
+  Entities *es = &g_state->entities;
+
+  VisibleEntities result = ZERO_STRUCT;
+  u32 type_count[ENTITY_TYPE_COUNT] = ZERO_STRUCT;
+  u32 *candidates = MEM_ARENA_PUSH_ARRAY(arena, u32, grid->hitbox_count);
+  u32 candidate_count = 0;
+
+  SpatialQuery q = ZERO_STRUCT;
+  SPATIAL_QUERY_FOR(&q, grid, view, h)
+  {
+    // NOTE(Ryan): Entity may have been freed since grid was built
+    EntitySlot *slot = entity_slot_from_handle(h->e);
+    if (slot == NULL || !CheckCollisionRecs(h->r, view)) continue;
+
+    candidates[candidate_count++] = slot->dense;
+    type_count[es->type[slot->dense]] += 1;
+  }
+
+  for (u32 t = 0; t < ENTITY_TYPE_COUNT; t += 1)
+  {
+    result.type_first[t + 1] = result.type_first[t] + type_count[t];
+    type_count[t] = result.type_first[t];
+  }
+
+  result.dense = MEM_ARENA_PUSH_ARRAY(arena, u32, candidate_count);
+  for (u32 i = 0; i < candidate_count; i += 1)
+  {
+    u32 dense = candidates[i];
+    result.dense[type_count[es->type[dense]]++] = dense;
+  }
+
+  return result;
 }
 
 INTERNAL void
@@ -152,43 +342,120 @@ inc_inventory_item_count(ENTITY_TYPE t, s32 inc)
   }
 }
 
-INTERNAL Texture
-get_texture_from_entity_type(ENTITY_TYPE type)
+INTERNAL Sprite
+get_sprite_from_entity_type(ENTITY_TYPE type)
 {
-  String8 texture_string = ZERO_STRUCT;
-  switch (type)
+  return assets_sprite(g_state->entity_sprite_ids[type]);
+}
+
+INTERNAL void
+entity_update_prepare(EntityUpdate *update, f32 entity_scale)
+{
+  for (EACH_NONZERO_ENUM(ENTITY_TYPE, type))
   {
-    default:
-    {
-      TraceLog(LOG_WARNING, "Failed to get texture");
-      return g_state->assets.default_texture;
-    } break;
-    case ENTITY_TYPE_PLAYER:
-    {
-      texture_string = str8_lit("assets/player.png");
-    } break;
-    case ENTITY_TYPE_ROCK:
-    {
-      texture_string = str8_lit("assets/rock.png");
-    } break;
-    case ENTITY_TYPE_TREE:
-    {
-      texture_string = str8_lit("assets/tree.png");
-    } break;
-    case ENTITY_TYPE_ITEM_PINEWOOD:
+    Sprite e_sprite = get_sprite_from_entity_type(type);
+    update->hitbox_sizes[type] = V2(e_sprite.src.width, e_sprite.src.height) * entity_scale;
+  }
+}
+
+INTERNAL Rectangle
+entity_hitbox(EntityUpdate *update, u32 i)
+{
+  Entities *es = &g_state->entities;
+  Vector2 size = update->hitbox_sizes[es->type[i]];
+  Vector2 e_world_pos = tile_to_world_pos(es->pos[i]);
+  Rectangle result = {e_world_pos.x, e_world_pos.y, size.x, size.y};
+  return result;
+}
+
+// NOTE(Ryan): Serial, as insertion dominates and is a pointer push per hitbox; 
+// splitting out just the rect maths into jobs measured slower
+INTERNAL void
+entity_hitbox_grid_build(SpatialGrid *grid, EntityUpdate *update)
+{
+  Entities *es = &g_state->entities;
+  for (u32 i = es->type_first[1]; i < es->type_first[ENTITY_TYPE_COUNT]; i += 1)
+  {
+    EntitySlot *slot = &es->slots[es->slot[i]];
+    spatial_grid_insert(grid, entity_hitbox(update, i), TO_HANDLE(slot));
+  }
+}
+
+// NOTE(Ryan): Workbench flag rather than type decides, so scan every building
+INTERNAL void
+entity_crafting_update(EntityUpdate *update)
+{
+  Entities *es = &g_state->entities;
+  for (u32 i = es->type_first[ENTITY_TYPE_BUILDING_FIRST]; i < es->type_first[ENTITY_TYPE_COUNT]; i += 1)
+  {
+    u32 slot_i = es->slot[i];
+    EntityCrafting *crafting = &es->crafting[slot_i];
+    if (HAS_FLAGS_ANY(es->flags[slot_i], ENTITY_FLAG_WORKBENCH) && crafting->queued_amount > 0)
     {
-      texture_string = str8_lit("assets/item-pinewood.png");
-    } break;
-    case ENTITY_TYPE_BUILDING_FURNACE:
+      if (f64_eq(crafting->timer_start, 0.0))
+      {
+        crafting->timer_start = update->time;
+      }
+
+    }
+  }
+}
+
+// NOTE(Ryan): Items whose hitbox centre is within pickup radius of player
+INTERNAL void
+entity_pickup(SpatialGrid *grid, Vector2 player_world)
+{
+  Entities *es = &g_state->entities;
+
+  Rectangle pickup_rect = {player_world.x - PLAYER_PICKUP_RADIUS, player_world.y - PLAYER_PICKUP_RADIUS,
+                           PLAYER_PICKUP_RADIUS*2, PLAYER_PICKUP_RADIUS*2};
+  SpatialQuery q = ZERO_STRUCT;
+  SPATIAL_QUERY_FOR(&q, grid, pickup_rect, h)
+  {
+    Rectangle r = h->r;
+    // NOTE(Ryan): Entity may have been freed earlier this frame
+    EntitySlot *slot = entity_slot_from_handle(h->e);
+    if (slot == NULL) continue;
+    ENTITY_TYPE type = es->type[slot->dense];
+    if (!entity_type_is_item(type)) continue;
+
+    Vector2 h_centre = {r.x + r.width*.5f, r.y + r.height*.5f};
+    if (Vector2LengthSqr(h_centre - player_world) < SQUARE(PLAYER_PICKUP_RADIUS))
     {
-      texture_string = str8_lit("assets/building-furnace.png");
-    } break;
-    case ENTITY_TYPE_BUILDING_WORKBENCH:
+      inc_inventory_item_count(type, 1);
+      entity_free(h->e);
+    }
+  }
+}
+
+// NOTE(Ryan): Closest non-item hitbox whose centre is within its radius of p
+INTERNAL Handle
+entity_pick(SpatialGrid *grid, Vector2 p, Rectangle *picked_rect)
+{
+  Entities *es = &g_state->entities;
+
+  Handle result = zero_handle_create();
+  f32 closest_hitbox_lengthsq = f32_inf();
+  Rectangle p_rect = {p.x, p.y, 0, 0};
+  SpatialQuery q = ZERO_STRUCT;
+  SPATIAL_QUERY_FOR(&q, grid, p_rect, h)
+  {
+    Rectangle r = h->r;
+    EntitySlot *slot = entity_slot_from_handle(h->e);
+    if (slot == NULL || entity_type_is_item(es->type[slot->dense])) continue;
+
+    f32 h_radius = MAX(r.width*.5f, r.height*.5f);
+    Vector2 h_centre = {r.x + r.width*.5f, r.y + r.height*.5f};
+    f32 lengthsq = Vector2LengthSqr(h_centre - p);
+    if (lengthsq < closest_hitbox_lengthsq && lengthsq <= SQUARE(h_radius))
     {
-      texture_string = str8_lit("assets/building-workbench.png");
-    } break;
+      result = h->e;
+      closest_hitbox_lengthsq = lengthsq;
+      if (picked_rect != NULL) *picked_rect = {h_centre.x, h_centre.y, h_radius, h_radius};
+    }
   }
-  return assets_get_texture(texture_string);
+
+  return result;
 }
 
 INTERNAL char *
@@ -233,11 +500,97 @@ get_pretty_name_from_entity_type(ENTITY_TYPE type)
   // TODO: have input consumption to establish a hierarchical nature (mouse_hovering and clicking important)
   // e.g: consume = inputs[code] &= ~(KEY_PRESSED);
   // simply add hover_consumed and click_consumed on Frame struct
+#if defined(PROFILER)
+// NOTE(Ryan): Goes through DBG text path, so must be within camera mode
+INTERNAL void
+draw_profiler_stats(void)
+{
+  if (profiler_history_count() == 0) return;
+
+  ProfileFrame *frame = profiler_history_frame(0);
+  draw_debug_text(str8_fmt(g_state->frame_arena, "frame = %.2fms", profiler_ticks_to_ms(frame->elapsed)));
+
+  // NOTE(Ryan): min/avg/max/p99 over history
+  ProfileThread *t = tl_profile_thread;
+  for (u32 i = 1; i < PROFILER_HISTORY_SLOTS; i += 1)
+  {
+    ProfileSlot *slot = &t->slots[i];
+    if (slot->hit_count == 0) continue;
+
+    ProfileSlotStats stats = profiler_slot_stats(i);
+    draw_debug_text(str8_fmt(g_state->frame_arena, "%s = %.2f/%.2f/%.2f/%.2fms", slot->label, 
+                             profiler_ticks_to_ms(stats.min), profiler_ticks_to_ms(stats.avg), 
+                             profiler_ticks_to_ms(stats.max), profiler_ticks_to_ms(stats.p99)));
+  }
+}
+
+// NOTE(Ryan): Screen space, i.e. outside camera mode
+INTERNAL void
+draw_profiler_graphs(f32 rw, f32 rh)
+{
+  u32 count = profiler_history_count();
+  if (count == 0) return;
+
+  f32 graph_w = rw * 0.4f;
+  f32 graph_h = rh * 0.15f;
+  f32 graph_x = rw - graph_w - 20.f;
+  f32 graph_y = rh - graph_h - 20.f;
+  f32 target_ms = 1000.f / 60.f;
+  // NOTE(Ryan): Full height is 2 missed frames
+  f32 px_per_ms = graph_h / (target_ms * 2.f);
+
+  // :frame time graph
+  DrawRectangleRec({graph_x, graph_y, graph_w, graph_h}, {0, 0, 0, 150});
+  f32 bar_w = graph_w / PROFILER_HISTORY_FRAMES;
+  for (u32 i = 0; i < count; i += 1)
+  {
+    f32 ms = (f32)profiler_ticks_to_ms(profiler_history_frame(i)->elapsed);
+    f32 bar_h = MIN(ms * px_per_ms, graph_h);
+    Rectangle bar = {graph_x + graph_w - (i + 1) * bar_w, graph_y + graph_h - bar_h, bar_w, bar_h};
+    DrawRectangleRec(bar, (ms > target_ms) ? RED : GREEN);
+  }
+  f32 target_y = graph_y + graph_h - target_ms * px_per_ms;
+  DrawLineV({graph_x, target_y}, {graph_x + graph_w, target_y}, YELLOW);
+
+#if PROFILER_TIMELINE
+  // :flame chart
+  // NOTE(Ryan): Last frame's timeline events, nested by containment
+  ProfileFrame *frame = profiler_history_frame(0);
+  ProfileThread *t = tl_profile_thread;
+  u64 end = frame->event_end;
+  u64 begin = MAX(frame->event_begin, end - MIN(end, 256));
+  f32 row_h = 18.f;
+  for (u64 i = begin; i < end; i += 1)
+  {
+    ProfileEvent *e = &t->events[i & (PROFILER_MAX_EVENTS - 1)];
+    u32 depth = 0;
+    for (u64 j = begin; j < end; j += 1)
+    {
+      ProfileEvent *p = &t->events[j & (PROFILER_MAX_EVENTS - 1)];
+      if (j != i && p->start <= e->start && p->start + p->elapsed >= e->start + e->elapsed) depth += 1;
+    }
+
+    f32 x = graph_x + graph_w * (f32)(e->start - frame->start) / (f32)frame->elapsed;
+    f32 w = MAX(graph_w * (f32)e->elapsed / (f32)frame->elapsed, 1.f);
+    Rectangle r = {x, graph_y - (depth + 1) * row_h, w, row_h - 2.f};
+    DrawRectangleRec(r, ORANGE);
+    if (w > 60.f) DrawText(e->label, (s32)r.x + 2, (s32)r.y + 2, 10, BLACK);
+  }
+#endif
+}
+#endif
+
 EXPORT void 
 code_update(State *state)
 { 
+  // NOTE(Ryan): Before this frame's block opens, so last frame's is complete
+  profiler_frame_snapshot();
+
   PROFILE_FUNCTION() {
   g_state = state;
+  // NOTE(Ryan): Reloadable code has its own thread locals, so adopt main thread's worker and scratch arenas
+  job_worker_get(&state->jobs);
+  g_mem_arena_failure_hook = arena_failure_warn;
 
 // TODO: move these into a WorldFrame struct
   f32 dt = GetFrameTime();
@@ -249,14 +602,14 @@ code_update(State *state)
     state->is_initialised = true;
     state->camera.zoom = 1.f;
 
-    state->hitbox_arena = mem_arena_allocate(MB(64), MB(64));
 
-    state->player = entity_create_player();
-    state->player->pos = world_to_tile_pos({rw/2, rh/2});
+    state->player = entity_create_player(world_to_tile_pos({rw/2, rh/2}));
+    state->hitbox_grid = spatial_grid_create(state->arena, HITBOX_GRID_SLOT_COUNT, TILE_WIDTH, MAX_ENTITIES);
+    state->prev_hitbox_grid = spatial_grid_create(state->arena, HITBOX_GRID_SLOT_COUNT, TILE_WIDTH, MAX_ENTITIES);
 
     // :init item data
-    ItemData *item_data = &state->item_data[ENTITY_TYPE_ITEM_FIRST - ENTITY_TYPE_ITEM_ROCK];
-    item_data->crafting_recipe = { {ENTITY_TYPE_ITEM_ROCK, 5}};
+    ItemData *item_data = &state->items[ENTITY_TYPE_ITEM_ROCK - ENTITY_TYPE_ITEM_FIRST];
+    item_data->crafting_recipe[0] = {ENTITY_TYPE_ITEM_ROCK, 5};
     item_data->crafting_recipe_count = 1;
 
     // IMPORTANT: this sets up the world with things for us (probably set globals as well)
@@ -264,25 +617,27 @@ code_update(State *state)
     u32 rand_seed = 1337;
     for (u32 i = 0; i < 10; i += 1)
     {
-      Entity *e = entity_create_rock();
-      e->pos = {f32_rand_range(&rand_seed, 0, 20), f32_rand_range(&rand_seed, 0, 20)};
-      e = entity_create_tree();
-      e->pos = {f32_rand_range(&rand_seed, 0, 20), f32_rand_range(&rand_seed, 0, 20)};
+      entity_create_rock({f32_rand_range(&rand_seed, 0, 20), f32_rand_range(&rand_seed, 0, 20)});
+      entity_create_tree({f32_rand_range(&rand_seed, 0, 20), f32_rand_range(&rand_seed, 0, 20)});
     }
     inc_inventory_item_count(ENTITY_TYPE_ITEM_PINEWOOD, 5);
 
-    Entity *e = entity_create_building_furnace();
-    e->pos = {10, 2};
+    entity_create_building_furnace({10, 2});
     
     #endif
   }
 
+  assets_update();
+
   if (IsKeyPressed(KEY_F)) 
   {
     if (IsWindowMaximized()) RestoreWindow();
     else MaximizeWindow();
   }
 
+  if (IsKeyPressed(KEY_F3)) state->is_profiler_overlay_visible = !state->is_profiler_overlay_visible;
+  if (IsKeyPressed(KEY_F9)) profiler_write_trace("build/trace.json");
+
   Vector2 player_dp = ZERO_STRUCT;
   f32 player_v = 8.f;
   if (IsKeyDown(KEY_UP)) player_dp.y -= 1;
@@ -291,76 +646,85 @@ code_update(State *state)
   if (IsKeyDown(KEY_RIGHT)) player_dp.x += 1;
   if (IsKeyDown(KEY_LEFT_SHIFT)) player_v *= 2.f;
   player_dp = Vector2Normalize(player_dp);
-  state->player->pos += (player_dp * player_v * dt);
+  Entities *es = &state->entities;
+  // NOTE(Ryan): Player passes are skipped if its handle no longer resolves
+  u32 player_i = entity_index(state->player);
+  b32 has_player = (player_i != ENTITY_INDEX_NIL);
+  Vector2 player_world = ZERO_STRUCT;
+  if (has_player)
+  {
+    Vector2 *player_pos = &es->pos[player_i];
+    *player_pos += (player_dp * player_v * dt);
+    player_world = tile_to_world_pos(*player_pos);
 
-  Vector2 cur_camera = state->camera.target;
-  Vector2 target_camera = tile_to_world_pos(state->player->pos);
-  state->camera.target += (target_camera - cur_camera) * f32_exp_out_slow(dt);
+    Vector2 cur_camera = state->camera.target;
+    state->camera.target += (player_world - cur_camera) * f32_exp_out_slow(dt);
+  }
 
   // TODO: add player sprite w/h to calculation
   state->camera.offset = V2(rw/2, rh/2) * state->camera.zoom;
 
+  // NOTE(Ryan): Rendering at 1920; Sprites done on 240
+  f32 entity_scale = 8.0f;
+
+  // :build entity hitbox grid
+  // NOTE(Ryan): Rebuilt each frame after movement, so hitboxes match what is drawn this frame.
+  // Last frame's grid is left intact; the one before it is recycled
+  SWAP(SpatialGrid, state->prev_hitbox_grid, state->hitbox_grid);
+  spatial_grid_clear(&state->hitbox_grid);
+  EntityUpdate *update = MEM_ARENA_PUSH_STRUCT_ZERO(state->frame_arena, EntityUpdate);
+  entity_update_prepare(update, entity_scale);
+  update->time = GetTime();
+  PROFILE_BLOCK("hitbox grid build")
+  {
+    entity_hitbox_grid_build(&state->hitbox_grid, update);
+  }
+
   // TODO: This is effectively entity update
-  // :process entity hitboxes
-  f32 closest_hitbox_lengthsq = f32_inf();
+  // :update entity hover
   Vector2 mouse_world = GetScreenToWorld2D(GetMousePosition(), state->camera);
-  Entity *e_hovering = NULL;
   Rectangle e_hovering_rect = ZERO_STRUCT;
-  Vector2 player_world = tile_to_world_pos(state->player->pos);
-  for (Hitbox *h = state->hitbox_stack; h != NULL; h = h->next)
-  {
-    Rectangle r = h->r;
-    Entity *e = h->e;
-    f32 h_radius = MAX(r.width*.5f, r.height*.5f);
-    Vector2 h_centre = {r.x + r.width*.5f, r.y + r.height*.5f};
-    f32 lengthsq = Vector2LengthSqr(h_centre - mouse_world);
-    if (lengthsq < closest_hitbox_lengthsq && 
-        lengthsq <= SQUARE(h_radius) && !e->is_item)
-    {
-      e_hovering= e;
-      closest_hitbox_lengthsq = lengthsq;
-      e_hovering_rect = {r.x + r.width*.5f, r.y + r.height*.5f, h_radius, h_radius};
-    }
-
-    // TODO: get player hitbox so can get distance from it's centre
-    lengthsq = Vector2LengthSqr(h_centre - player_world);
-    if (e->is_item && lengthsq < SQUARE(PLAYER_PICKUP_RADIUS))
-    {
-      inc_inventory_item_count(e->type, 1);
-      entity_free(e);
-    }
+  // NOTE(Ryan): Pick against last frame's hitboxes, i.e. what was on screen when mouse moved
+  Handle e_hovering = entity_pick(&state->prev_hitbox_grid, mouse_world, &e_hovering_rect);
 
-    if (e->is_workbench && state->active_crafting_item)
-    {
-      if (e->crafting_timer_start == 0)
-      {
-        e->crafting_timer_start = GetTime();
-      }
+  // :update item pickup
+  // TODO: get player hitbox so can get distance from it's centre
+  PROFILE_BLOCK("item pickup")
+  {
+    if (has_player) entity_pickup(&state->hitbox_grid, player_world);
+  }
 
-    }
+  // :update crafting
+  PROFILE_BLOCK("crafting")
+  {
+    entity_crafting_update(update);
   }
-  mem_arena_clear(state->hitbox_arena);
-  state->hitbox_stack = NULL;
 
   // :update entity destroy
-  if (e_hovering != NULL && e_hovering->is_destroyable && left_click_consume())
+  EntitySlot *e_hovering_slot = entity_slot_from_handle(e_hovering);
+  ENTITY_FLAG e_hovering_flags = 0;
+  if (e_hovering_slot != NULL) e_hovering_flags = es->flags[e_hovering_slot - es->slots];
+  PROFILE_BLOCK("entity destroy") {
+  if (HAS_FLAGS_ANY(e_hovering_flags, ENTITY_FLAG_DESTROYABLE) && left_click_consume())
   {
-    e_hovering->health -= 1;
-    if (e_hovering->health <= 0)
+    u32 i = e_hovering_slot->dense;
+    es->health[i] -= 1;
+    if (es->health[i] <= 0)
     {
-      switch (e_hovering->type)
+      switch (es->type[i])
       {
         case ENTITY_TYPE_TREE:
         {
-          Entity *e = entity_create_item_pinewood();
-          e->pos = e_hovering->pos;
+          entity_create_item_pinewood(es->pos[i]);
         } break;
       }
       entity_free(e_hovering);
+      e_hovering_flags = 0;
     }
   }
+  }
 
-  if (e_hovering != NULL && e_hovering->is_workbench && left_click_consume())
+  if (HAS_FLAGS_ANY(e_hovering_flags, ENTITY_FLAG_WORKBENCH) && left_click_consume())
   {
     state->ui_state = UI_STATE_WORKBENCH;
     state->open_workbench = e_hovering;
@@ -370,52 +734,76 @@ code_update(State *state)
   ClearBackground(RAYWHITE);
   BeginMode2D(state->camera);
 
+  SpatialQuery q = ZERO_STRUCT;
+  PROFILE_BLOCK("render world") {
+  // :cull view
+  Vector2 view_min = GetScreenToWorld2D({0, 0}, state->camera);
+  Vector2 view_max = GetScreenToWorld2D({(f32)rw, (f32)rh}, state->camera);
+  Rectangle view = {view_min.x, view_min.y, view_max.x - view_min.x, view_max.y - view_min.y};
 
   // :render map
-  Vector2 player_tile = state->camera.target / TILE_SIZE;
-  for (u32 i = 0; i < 16*16; i += 1)
+  s32 tile_x0 = F32_FLOOR_S32(view.x / TILE_WIDTH), tile_x1 = F32_CEIL_S32((view.x + view.width) / TILE_WIDTH);
+  s32 tile_y0 = F32_FLOOR_S32(view.y / TILE_HEIGHT), tile_y1 = F32_CEIL_S32((view.y + view.height) / TILE_HEIGHT);
+  for (s32 y = tile_y0; y < tile_y1; y += 1)
   {
-    u32 x = i % 16;
-    u32 y = i / 16;
-    Color c = (x + y) & 1 ? GREEN : BROWN;
-    Rectangle tile_rec = {(player_tile.x - 8 + x) * TILE_WIDTH, 
-                          (player_tile.y - 8 + y) * TILE_HEIGHT, 
-                          TILE_WIDTH, TILE_HEIGHT};
-    DrawRectangleRec(tile_rec, c);
+    for (s32 x = tile_x0; x < tile_x1; x += 1)
+    {
+      Color c = (x + y) & 1 ? GREEN : BROWN;
+      Rectangle tile_rec = {(f32)x * TILE_WIDTH, (f32)y * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT};
+      DrawRectangleRec(tile_rec, c);
+    }
   }
 
-  // NOTE(Ryan): Rendering at 1920; Sprites done on 240
   // :render entities
-  f32 entity_scale = 8.0f;
-  for (u32 i = 0; i < ARRAY_COUNT(state->entities); i += 1)
+  // NOTE(Ryan): Grow view so bobbing items aren't popped at edges
+  f32 bob_height = entity_scale * 5;
+  Rectangle cull_view = {view.x, view.y - bob_height, view.width, view.height + bob_height*2};
+  VisibleEntities visible = entity_cull(state->frame_arena, &state->hitbox_grid, cull_view);
+  for (EACH_NONZERO_ENUM(ENTITY_TYPE, type))
   {
-    Entity *e = &g_state->entities[i];
-    if (!e->is_active) continue;
-    Texture e_texture = get_texture_from_entity_type(e->type);
-    Vector2 e_world_pos = tile_to_world_pos(e->pos);
-    if (e->type == ENTITY_TYPE_ITEM_PINEWOOD)
-    {
-      e_world_pos.y += (entity_scale * 5 * f32_sin_in_out(GetTime()));
-    }
+    u32 first = visible.type_first[type], end = visible.type_first[type + 1];
+    if (first == end) continue;
+
+    Sprite e_sprite = get_sprite_from_entity_type(type);
     Color tint = BLACK;
-    if (e_texture.id == state->assets.default_texture.id) tint = WHITE;
+    if (e_sprite.texture.id == state->assets.default_texture.id) tint = WHITE;
+    Vector2 texture_size = V2(e_sprite.src.width, e_sprite.src.height) * entity_scale;
+    b32 is_building = (type >= ENTITY_TYPE_BUILDING_FIRST && type <= ENTITY_TYPE_BUILDING_LAST);
 
-    DrawTextureEx(e_texture, e_world_pos, 0.f, entity_scale, tint);
-    
-    // IMPORTANT: render and update just switches on entity types
-    if (e->is_workbench && e->queued_crafting_amount > 0)
+    for (u32 v = first; v < end; v += 1)
     {
-      // draw animation (two circles; inner radius expands)
-      f32 a = f32_norm(e->crafting_timer_start, GetTime(), e->crafting_timer_start+length);
+      u32 i = visible.dense[v];
+      Vector2 e_world_pos = tile_to_world_pos(es->pos[i]);
+      if (type == ENTITY_TYPE_ITEM_PINEWOOD)
+      {
+        e_world_pos.y += (bob_height * f32_sin_in_out(GetTime()));
+      }
+
+      Rectangle e_dst = {e_world_pos.x, e_world_pos.y, texture_size.x, texture_size.y};
+      DrawTexturePro(e_sprite.texture, e_sprite.src, e_dst, {0, 0}, 0.f, tint);
+
+      // IMPORTANT: render and update just switches on entity types
+      u32 slot_i = es->slot[i];
+      if (is_building && HAS_FLAGS_ANY(es->flags[slot_i], ENTITY_FLAG_WORKBENCH))
+      {
+        EntityCrafting *crafting = &es->crafting[slot_i];
+        if (crafting->queued_amount > 0)
+        {
+          // draw animation (two circles; inner radius expands)
+          f32 length = state->items[crafting->entity - ENTITY_TYPE_ITEM_FIRST].craft_length;
+          f32 a = f32_norm(crafting->timer_start, GetTime(), crafting->timer_start+length);
+        }
+      }
     }
+  }
 
-    Vector2 texture_size = V2(e_texture.width, e_texture.height) * entity_scale;
-    Rectangle e_hitbox = {e_world_pos.x, e_world_pos.y, texture_size.x, texture_size.y};
-    DrawRectangleLinesEx(e_hitbox, 2.0f, MAGENTA);
-    Hitbox *h = MEM_ARENA_PUSH_STRUCT(state->hitbox_arena, Hitbox);
-    h->r = e_hitbox;
-    h->e = e;
-    SLL_STACK_PUSH(g_state->hitbox_stack, h);
+  // :render hitboxes
+  // NOTE(Ryan): Separate pass so outlines don't interrupt atlas sprite batch
+  SPATIAL_QUERY_FOR(&q, &state->hitbox_grid, view, h)
+  {
+    if (entity_slot_from_handle(h->e) == NULL) continue;
+    DrawRectangleLinesEx(h->r, 2.0f, MAGENTA);
+  }
   }
 
   if (IsKeyReleased(KEY_TAB)) 
@@ -430,6 +818,7 @@ code_update(State *state)
     else state->ui_state = UI_STATE_BUILDINGS;
   }
 
+  PROFILE_BLOCK("render ui") {
   // :render overlays
   DrawCircle(e_hovering_rect.x, e_hovering_rect.y, e_hovering_rect.width, {122, 33, 11, 180});
   // :render inventory ui
@@ -457,7 +846,8 @@ code_update(State *state)
       ENTITY_TYPE type = (i + ENTITY_TYPE_ITEM_FIRST);
       if (item->amount > 0)
       {
-        Texture t = get_texture_from_entity_type(type);
+        Sprite sprite = get_sprite_from_entity_type(type);
+        Rectangle t = sprite.src;
         f32 t_scale = 0.f;
         if (t.width > t.height) t_scale = (box_w / t.width);
         else t_scale = (h / t.height);
@@ -479,7 +869,7 @@ code_update(State *state)
                              box.y + box.height*0.5f - t_scaled.y*0.5f};
 
         // IMPORTANT: after setting origin to centre, we must now pass the centre as draw point
-        DrawTexturePro(t, {0, 0, t.width, t.height}, 
+        DrawTexturePro(sprite.texture, t, 
                       {t_centered.x + t_scaled.x*0.5f, t_centered.y + t_scaled.y*0.5f, t_scaled.x, t_scaled.y},
                       {t_scaled.x*0.5f, t_scaled.y*0.5f},
                       t_rotation, WHITE);
@@ -497,11 +887,9 @@ code_update(State *state)
           String8 text_fmt = str8_fmt(state->frame_arena, "%s (%d)", 
                                       get_pretty_name_from_entity_type(type),
                                       item->amount);
-          char *text = (char *)text_fmt.content;
-          Font font = assets_get_font(str8_lit("assets/Alegreya-Regular.ttf"));
-          Vector2 text_size = MeasureTextEx(font, text, font_size, 1.f);
+          Vector2 text_size = text_measure(state->ui_font_id, text_fmt, font_size, 1.f);
           Vector2 text_pos = {tooltip.x + tooltip.width*0.5f - text_size.x*0.5f, tooltip.y};
-          DrawTextEx(font, text, text_pos, font_size, 1.f, WHITE);
+          text_draw(state->ui_font_id, text_fmt, text_pos, font_size, 1.f, WHITE);
         }
       }
     }
@@ -526,7 +914,8 @@ code_update(State *state)
 
       InventoryItem *item = &state->inventory_items[i];
       ENTITY_TYPE type = (i + ENTITY_TYPE_BUILDING_FIRST);
-      Texture t = get_texture_from_entity_type(type);
+      Sprite sprite = get_sprite_from_entity_type(type);
+      Rectangle t = sprite.src;
       f32 t_scale = 0.f;
       if (t.width > t.height)
         t_scale = (box_w / t.width);
@@ -550,7 +939,7 @@ code_update(State *state)
                             box.y + box.height * 0.5f - t_scaled.y * 0.5f};
 
       // IMPORTANT: after setting origin to centre, we must now pass the centre as draw point
-      DrawTexturePro(t, {0, 0, t.width, t.height},
+      DrawTexturePro(sprite.texture, t,
                      {t_centered.x + t_scaled.x * 0.5f, t_centered.y + t_scaled.y * 0.5f, t_scaled.x, t_scaled.y},
                      {t_scaled.x * 0.5f, t_scaled.y * 0.5f},
                      t_rotation, WHITE);
@@ -568,11 +957,9 @@ code_update(State *state)
         f32 font_size = 48.f;
         String8 text_fmt = str8_fmt(state->frame_arena, "%s",
                                     get_pretty_name_from_entity_type(type));
-        char *text = (char *)text_fmt.content;
-        Font font = assets_get_font(str8_lit("assets/Alegreya-Regular.ttf"));
-        Vector2 text_size = MeasureTextEx(font, text, font_size, 1.f);
+        Vector2 text_size = text_measure(state->ui_font_id, text_fmt, font_size, 1.f);
         Vector2 text_pos = {tooltip.x + tooltip.width * 0.5f - text_size.x * 0.5f, tooltip.y};
-        DrawTextEx(font, text, text_pos, font_size, 1.f, WHITE);
+        text_draw(state->ui_font_id, text_fmt, text_pos, font_size, 1.f, WHITE);
 
         if (left_click_consume()) state->active_building_type = type;
       }
@@ -584,16 +971,29 @@ code_update(State *state)
   {
     BuildingData *bd = &state->buildings[state->active_building_type - ENTITY_TYPE_BUILDING_FIRST];
     
-    Texture t = get_texture_from_entity_type(state->active_building_type);
+    Sprite sprite = get_sprite_from_entity_type(state->active_building_type);
+    Rectangle t = sprite.src;
     // TODO: get_aligned_vec_from_rect(rect, ALIGN_CENTRE);
 
     Vector2 pos = round_world_to_tile(mouse_world);
-    DrawTextureEx(t, pos, 0.f, entity_scale, WHITE);
+    Rectangle placement = {pos.x, pos.y, t.width * entity_scale, t.height * entity_scale};
+    b32 is_blocked = false;
+    SPATIAL_QUERY_FOR(&q, &state->hitbox_grid, placement, h)
+    {
+      EntitySlot *slot = entity_slot_from_handle(h->e);
+      if (slot == NULL || entity_type_is_item(es->type[slot->dense])) continue;
+      if (CheckCollisionRecs(h->r, placement))
+      {
+        is_blocked = true;
+        break;
+      }
+    }
+
+    DrawTexturePro(sprite.texture, t, placement, {0, 0}, 0.f, is_blocked ? RED : WHITE);
     //DrawRectangleLines(pos.x, pos.y, t.width, t.height, MAGENTA);
-    if (left_click_consume()) 
+    if (!is_blocked && left_click_consume()) 
     {
-      Entity *e = entity_create_building_furnace();
-      e->pos = world_to_tile_pos(pos);
+      entity_create_building_furnace(world_to_tile_pos(pos));
       state->active_building_type = ENTITY_TYPE_NIL;
     }
   }
@@ -612,15 +1012,24 @@ code_update(State *state)
     // right pane displays selected research progress bar
     // hitting button spends 'research' item
   }
-
+  }
 
   Vector2 fps_pos = GetScreenToWorld2D({20, 20}, state->camera);
   DrawFPS(fps_pos.x, fps_pos.y);
 
+#if defined(PROFILER)
+  if (state->is_profiler_overlay_visible) draw_profiler_stats();
+#endif
+
   g_dbg_at_y = 0.f;
   state->left_click_consumed = false;
 
   EndMode2D();
+
+#if defined(PROFILER)
+  if (state->is_profiler_overlay_visible) draw_profiler_graphs((f32)rw, (f32)rh);
+#endif
+
   EndDrawing();
   }
 }
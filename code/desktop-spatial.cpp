@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#include "desktop-spatial.h"
+
+INTERNAL u32
+spatial_cell_hash(s32 x, s32 y)
+{
+  return ((u32)x * 73856093u) ^ ((u32)y * 19349663u);
+}
+
+INTERNAL s32
+spatial_cell_coord(SpatialGrid *grid, f32 v)
+{
+  return F32_FLOOR_S32(v / grid->cell_size);
+}
+
+// IMPORTANT(Ryan): slot_count must be a power of 2.
+// Slot heads are pushed onto arena, hitboxes come from grid's own pool sized for hitbox_capacity
+INTERNAL SpatialGrid
+spatial_grid_create(MemArena *arena, u32 slot_count, f32 cell_size, u32 hitbox_capacity)
+{
+  ASSERT(IS_POW2(slot_count));
+
+  SpatialGrid grid = ZERO_STRUCT;
+  grid.slots = MEM_ARENA_PUSH_ARRAY_ZERO(arena, Hitbox *, slot_count);
+  grid.slot_count = slot_count;
+  grid.cell_size = cell_size;
+  grid.hitbox_pool = MEM_POOL_CREATE(sizeof(Hitbox) * hitbox_capacity, Hitbox);
+
+  return grid;
+}
+
+// NOTE(Ryan): Only slot heads are zeroed, hitboxes are recycled untouched
+INTERNAL void
+spatial_grid_clear(SpatialGrid *grid)
+{
+  MEMORY_ZERO(grid->slots, sizeof(Hitbox *) * grid->slot_count);
+  mem_pool_reset(&grid->hitbox_pool);
+  grid->max_half_extent = ZERO_STRUCT;
+  grid->hitbox_count = 0;
+}
+
+// NOTE(Ryan): Slot heads are left to their arena
+INTERNAL void
+spatial_grid_release(SpatialGrid *grid)
+{
+  mem_pool_release(&grid->hitbox_pool);
+}
+
+INTERNAL Hitbox *
+spatial_grid_insert(SpatialGrid *grid, Rectangle r, Handle e)
+{
+  Hitbox *h = MEM_POOL_ALLOC(&grid->hitbox_pool, Hitbox);
+  if (h == NULL) return h;
+
+  h->r = r;
+  h->e = e;
+
+  Vector2 half_extent = {r.width*.5f, r.height*.5f};
+  h->cell_x = spatial_cell_coord(grid, r.x + half_extent.x);
+  h->cell_y = spatial_cell_coord(grid, r.y + half_extent.y);
+
+  u32 slot_i = spatial_cell_hash(h->cell_x, h->cell_y) & (grid->slot_count - 1);
+  SLL_STACK_PUSH(grid->slots[slot_i], h);
+
+  grid->max_half_extent.x = MAX(grid->max_half_extent.x, half_extent.x);
+  grid->max_half_extent.y = MAX(grid->max_half_extent.y, half_extent.y);
+  grid->hitbox_count += 1;
+
+  return h;
+}
+
+// NOTE(Ryan): Compare cell as different cells can hash to the same slot
+INTERNAL Hitbox *
+spatial_query_next(SpatialQuery *q)
+{
+  while (q->y <= q->max_y)
+  {
+    while (q->chain != NULL)
+    {
+      Hitbox *h = q->chain;
+      q->chain = h->next;
+      if (h->cell_x == q->x && h->cell_y == q->y) return h;
+    }
+
+    q->x += 1;
+    if (q->x > q->max_x)
+    {
+      q->x = q->min_x;
+      q->y += 1;
+    }
+    if (q->y <= q->max_y)
+    {
+      q->chain = q->grid->slots[spatial_cell_hash(q->x, q->y) & (q->grid->slot_count - 1)];
+    }
+  }
+
+  return NULL;
+}
+
+// NOTE(Ryan): Yields a superset of hitboxes overlapping r, i.e. only those in neighbouring cells.
+// Callers perform their own exact test
+INTERNAL Hitbox *
+spatial_query_begin(SpatialQuery *q, SpatialGrid *grid, Rectangle r)
+{
+  *q = ZERO_STRUCT;
+  q->grid = grid;
+  if (grid->hitbox_count == 0) 
+  {
+    q->max_y = -1;
+    return NULL;
+  }
+
+  q->min_x = spatial_cell_coord(grid, r.x - grid->max_half_extent.x);
+  q->min_y = spatial_cell_coord(grid, r.y - grid->max_half_extent.y);
+  q->max_x = spatial_cell_coord(grid, r.x + r.width + grid->max_half_extent.x);
+  q->max_y = spatial_cell_coord(grid, r.y + r.height + grid->max_half_extent.y);
+
+  q->x = q->min_x;
+  q->y = q->min_y;
+  q->chain = grid->slots[spatial_cell_hash(q->x, q->y) & (grid->slot_count - 1)];
+
+  return spatial_query_next(q);
+}
+
+#define SPATIAL_QUERY_FOR(q, grid, r, h) \
+  for (Hitbox *h = spatial_query_begin((q), (grid), (r)); h != NULL; h = spatial_query_next(q))
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#if !defined(DESKTOP_SPATIAL_H)
+#define DESKTOP_SPATIAL_H
+
+#include <raylib.h>
+
+typedef struct Hitbox Hitbox;
+struct Hitbox
+{
+  Hitbox *next;
+  Rectangle r;
+  Handle e;
+  s32 cell_x, cell_y;
+};
+
+// NOTE(Ryan): Uniform grid hashed into a fixed number of slots, so world can be unbounded.
+// Hitboxes are bucketed by the cell of their centre and chained through Hitbox::next
+typedef struct SpatialGrid SpatialGrid;
+struct SpatialGrid
+{
+  Hitbox **slots;
+  u32 slot_count;
+  MemPool hitbox_pool;
+  f32 cell_size;
+  // NOTE(Ryan): Queries are widened by this so hitboxes straddling cells aren't missed
+  Vector2 max_half_extent;
+  u32 hitbox_count;
+};
+
+typedef struct SpatialQuery SpatialQuery;
+struct SpatialQuery
+{
+  SpatialGrid *grid;
+  s32 min_x, min_y;
+  s32 max_x, max_y;
+  s32 x, y;
+  Hitbox *chain;
+};
+
+#endif
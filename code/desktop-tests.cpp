@@ -11,56 +11,628 @@ EXPORT_BEGIN
 #include <cmocka.h>
 EXPORT_END
 
-EXPORT void mov_all_bytes_asm(u8 *data, u32 count);
+#include "desktop-benchmarks.cpp"
+
+void
+test_example(void **state)
+{
+
+}
+
+void
+test_arena_commit(void **state)
+{
+  MemArena *arena = mem_arena_allocate(GB(1), MB(1));
+  assert_non_null(arena);
+  assert_int_equal(arena->commit_pos, MB(1));
+
+  u8 *a = (u8 *)mem_arena_push(arena, MB(3));
+  MEMORY_ZERO(a, MB(3));
+  assert_int_equal(arena->commit_pos, MB(4));
+  a[MB(3) - 1] = 0xff;
+
+  // NOTE(Ryan): Decommitted pages are zero-filled on next touch
+  mem_arena_clear(arena);
+  assert_int_equal(arena->commit_pos, MB(1));
+  u8 *b = (u8 *)mem_arena_push(arena, MB(3));
+  assert_ptr_equal(a, b);
+  assert_int_equal(b[MB(3) - 1], 0);
+
+  mem_arena_deallocate(arena);
+}
+
+GLOBAL u32 g_test_arena_failures;
 INTERNAL void
-mov_all_bytes_asm_repeat(RepetitionTester *tester, u32 count)
+test_arena_failure_hook(MemArena *arena, memory_index size)
+{
+  g_test_arena_failures += 1;
+}
+
+void
+test_arena_chain(void **state)
+{
+  MemArena *arena = mem_arena_allocate(MB(1), KB(64));
+  assert_non_null(arena);
+  u8 *a = (u8 *)mem_arena_push(arena, KB(768));
+  u8 *b = (u8 *)mem_arena_push(arena, KB(768));
+  assert_non_null(b);
+  assert_int_equal(arena->block_count, 2);
+  assert_true(b < a || b >= a + KB(768));
+
+  // NOTE(Ryan): Oversized push gets its own block
+  u8 *c = (u8 *)mem_arena_push(arena, MB(3));
+  assert_non_null(c);
+  c[MB(3) - 1] = 1;
+  assert_int_equal(arena->block_count, 3);
+  memory_index high_water = arena->high_water;
+
+  mem_arena_reset(arena);
+  assert_int_equal(arena->block_count, 1);
+  assert_ptr_equal(mem_arena_push(arena, KB(768)), a);
+  assert_int_equal(arena->high_water, high_water);
+  mem_arena_deallocate(arena);
+
+  mem_arena_failure_hook_t prev_hook = g_mem_arena_failure_hook;
+  g_mem_arena_failure_hook = test_arena_failure_hook;
+  MemArena *fixed = mem_arena_allocate_flags(MB(1), KB(64), 0);
+  assert_non_null(fixed);
+  assert_null(mem_arena_push(fixed, MB(2)));
+  assert_int_equal(fixed->failed_push_count, 1);
+  assert_int_equal(g_test_arena_failures, 1);
+  mem_arena_deallocate(fixed);
+  g_mem_arena_failure_hook = prev_hook;
+}
+
+void
+test_frame_arenas_flip(void **state)
 {
-  while (update_tester(tester))
+  State *s = g_state;
+  MemArena *first = s->frame_arena;
+  u32 *value = MEM_ARENA_PUSH_STRUCT(s->frame_arena, u32);
+  *value = 42;
+
+  frame_arenas_flip(s);
+  s->frame_counter += 1;
+  assert_ptr_equal(s->prev_frame_arena, first);
+  assert_ptr_not_equal(s->frame_arena, first);
+  MEM_ARENA_PUSH_STRUCT(s->frame_arena, u32);
+  assert_int_equal(*value, 42);
+
+  // NOTE(Ryan): Frame N-2 is recycled
+  frame_arenas_flip(s);
+  s->frame_counter += 1;
+  assert_ptr_equal(s->frame_arena, first);
+  assert_int_equal(mem_arena_pos(first), sizeof(MemArena));
+}
+
+void
+test_entity_handles(void **state)
+{
+  Handle a = entity_create_rock({1, 1});
+  EntitySlot *a_slot = entity_slot_from_handle(a);
+  assert_non_null(a_slot);
+
+  entity_free(a);
+  assert_null(entity_slot_from_handle(a));
+  assert_int_equal(entity_index(a), ENTITY_INDEX_NIL);
+
+  // NOTE(Ryan): Freed slot is reused, however old handle must remain stale
+  Handle b = entity_create_tree({2, 2});
+  assert_ptr_equal(entity_slot_from_handle(b), a_slot);
+  assert_null(entity_slot_from_handle(a));
+
+  assert_null(entity_slot_from_handle(zero_handle_create()));
+
+  entity_free(b);
+}
+
+void
+test_entity_type_ranges(void **state)
+{
+  Entities *es = &g_state->entities;
+
+  Handle handles[16] = ZERO_STRUCT;
+  ENTITY_TYPE types[] = {ENTITY_TYPE_BUILDING_FURNACE, ENTITY_TYPE_ROCK, ENTITY_TYPE_ITEM_PINEWOOD, ENTITY_TYPE_TREE};
+  for (u32 i = 0; i < ARRAY_COUNT(handles); i += 1)
+  {
+    handles[i] = entity_alloc(types[i % ARRAY_COUNT(types)]);
+    es->pos[entity_index(handles[i])] = {(f32)i, 0};
+  }
+  for (u32 i = 0; i < ARRAY_COUNT(handles); i += 3)
+  {
+    entity_free(handles[i]);
+  }
+
+  for (EACH_NONZERO_ENUM(ENTITY_TYPE, t))
   {
-    TIME_TEST(tester)
+    assert_true(es->type_first[t] <= es->type_first[t + 1]);
+    for (u32 i = es->type_first[t]; i < es->type_first[t + 1]; i += 1)
     {
-      u8 *m = (u8 *)malloc(count);
-      if (m != NULL)
-      {
-        mov_all_bytes_asm(m, count);
-        tester_count_bytes(tester, count);
-        free(m);
-      } 
-      else
-      {
-        tester_set_error(tester, "Malloc failed");
-      }
+      assert_int_equal(es->type[i], t);
+      assert_int_equal(es->slots[es->slot[i]].dense, i);
+    }
+  }
+  assert_int_equal(es->type_first[ENTITY_TYPE_COUNT], es->count);
+
+  for (u32 i = 0; i < ARRAY_COUNT(handles); i += 1)
+  {
+    u32 dense = entity_index(handles[i]);
+    if (i % 3 == 0) assert_int_equal(dense, ENTITY_INDEX_NIL);
+    else assert_true(f32_eq(es->pos[dense].x, (f32)i));
+    entity_free(handles[i]);
+  }
+  assert_int_equal(es->count, 0);
+}
+
+void
+test_mem_pool(void **state)
+{
+  MEM_ARENA_TEMP_BLOCK(temp, NULL, 0)
+  {
+    u32 *outside = MEM_ARENA_PUSH_STRUCT(temp.arena, u32);
+    *outside = 0xC0FFEE;
+
+    MemPool pool = MEM_POOL_CREATE(KB(64), Hitbox);
+    Hitbox *a = MEM_POOL_ALLOC(&pool, Hitbox);
+    Hitbox *b = MEM_POOL_ALLOC(&pool, Hitbox);
+    assert_ptr_not_equal(a, b);
+    assert_int_equal(pool.count, 2);
+
+    mem_pool_free(&pool, a);
+    assert_int_equal(pool.count, 1);
+    assert_ptr_equal(MEM_POOL_ALLOC(&pool, Hitbox), a);
+
+    // NOTE(Ryan): Bulk reset hands out same memory again, without zeroing it or touching other arenas
+    b->cell_x = 42;
+    mem_pool_reset(&pool);
+    assert_int_equal(pool.count, 0);
+    assert_ptr_equal(MEM_POOL_ALLOC(&pool, Hitbox), a);
+    assert_ptr_equal(MEM_POOL_ALLOC(&pool, Hitbox), b);
+    assert_int_equal(b->cell_x, 42);
+    assert_int_equal(*outside, 0xC0FFEE);
+
+    mem_pool_release(&pool);
+  }
+}
+
+void
+test_spatial_grid_query(void **state)
+{
+  MEM_ARENA_TEMP_BLOCK(temp, NULL, 0)
+  {
+    MemArena *arena = temp.arena;
+    // NOTE(Ryan): 2 slots guarantees distinct cells collide in the same slot
+    SpatialGrid grid = spatial_grid_create(arena, 2, 10.f, 16);
+    Handle near_a = handle_create((void *)0x10, 1);
+    Handle near_b = handle_create((void *)0x20, 1);
+    Handle far = handle_create((void *)0x30, 1);
+    spatial_grid_insert(&grid, {1, 1, 4, 4}, near_a);
+    spatial_grid_insert(&grid, {8, 8, 4, 4}, near_b);
+    spatial_grid_insert(&grid, {500, -500, 4, 4}, far);
+
+    u32 found = 0;
+    SpatialQuery q = ZERO_STRUCT;
+    Rectangle near_r = {4, 4, 5, 5};
+    SPATIAL_QUERY_FOR(&q, &grid, near_r, h)
+    {
+      assert_true(h->e.addr != far.addr);
+      found += 1;
+    }
+    assert_int_equal(found, 2);
+
+    found = 0;
+    Rectangle far_r = {499, -501, 2, 2};
+    SPATIAL_QUERY_FOR(&q, &grid, far_r, h)
+    {
+      assert_ptr_equal(h->e.addr, far.addr);
+      found += 1;
     }
+    assert_int_equal(found, 1);
+
+    spatial_grid_clear(&grid);
+    assert_int_equal(grid.hitbox_pool.count, 0);
+    found = 0;
+    SPATIAL_QUERY_FOR(&q, &grid, far_r, h) found += 1;
+    assert_int_equal(found, 0);
+
+    spatial_grid_release(&grid);
   }
+}
+
+void
+test_assets_intern(void **state)
+{
+  Assets *assets = &g_state->assets;
+  assets->key_slots = MEM_ARENA_PUSH_ARRAY_ZERO(assets->arena, AssetKeySlot, ASSETS_NUM_SLOTS);
+  assets->id_count = 1;
+
+  char path[] = "assets/rock.png";
+  ASSET_ID a = assets_intern(str8_lit("assets/rock.png"));
+  ASSET_ID b = assets_intern(str8_lit("assets/tree.png"));
+  assert_int_not_equal(a, ASSET_ID_NIL);
+  assert_int_not_equal(a, b);
+
+  // NOTE(Ryan): Key is copied, so id remains stable after source buffer changes
+  ASSET_ID c = assets_intern(str8_cstr(path));
+  assert_int_equal(a, c);
+  path[0] = 'x';
+  assert_true(str8_match(assets->keys[a], str8_lit("assets/rock.png"), 0));
+
+  // NOTE(Ryan): Pack entry is stale when its source is newer than pack
+  AssetPackEntry entry = ZERO_STRUCT;
+  str8_to_cstr(str8_lit("assets/player.png"), entry.key, sizeof(entry.key));
+  entry.key_hash = str8_hash(str8_lit("assets/player.png"));
+  assets->pack_entries = &entry;
+  assets->pack_entry_count = 1;
+  assets->pack_modify_time = 1;
+  ASSET_ID stale = assets_intern(str8_lit("assets/player.png"));
+  assert_int_equal(assets->pack_indices[stale], 0);
+  assert_null(assets_pack_entry(stale));
 
+  assets->pack_modify_time = U64_MAX;
+  assets_pack_bind(assets, stale);
+  assert_ptr_equal(assets_pack_entry(stale), &entry);
+
+  MemArena *assets_arena = assets->arena;
+  mem_arena_clear(assets_arena);
+  *assets = ZERO_STRUCT;
+  assets->arena = assets_arena;
 }
 
+void
+test_asset_load_queue(void **state)
+{
+  AssetLoadQueue *q = (AssetLoadQueue *)calloc(1, sizeof(AssetLoadQueue));
+  asset_load_queue_init(q);
+
+  AssetLoad load = ZERO_STRUCT;
+  for (u32 i = 0; i < ASSETS_LOAD_QUEUE_SIZE; i += 1)
+  {
+    load.id = i;
+    assert_true(asset_load_queue_push(q, &load));
+  }
+  assert_false(asset_load_queue_push(q, &load));
+
+  for (u32 i = 0; i < ASSETS_LOAD_QUEUE_SIZE; i += 1)
+  {
+    assert_true(asset_load_queue_pop(q, &load));
+    assert_int_equal(load.id, i);
+  }
+  assert_false(asset_load_queue_pop(q, &load));
+
+  thread_cv_destroy(&q->cv);
+  thread_mutex_destroy(&q->mutex);
+  free(q);
+}
+
+void
+test_text_run_cache(void **state)
+{
+  Assets *assets = &g_state->assets;
+  TextCache *cache = &g_state->text_cache;
+
+  // NOTE(Ryan): Hand-built font, so no GL context required
+  GlyphInfo glyphs[2] = ZERO_STRUCT;
+  glyphs[0].value = 'a'; glyphs[0].advanceX = 10;
+  glyphs[1].value = 'b'; glyphs[1].advanceX = 20;
+  Rectangle recs[2] = {{0, 0, 8, 16}, {8, 0, 18, 16}};
+  Font font = ZERO_STRUCT;
+  font.baseSize = 16;
+  font.glyphCount = 2;
+  font.glyphs = glyphs;
+  font.recs = recs;
+
+  ASSET_ID id = 1;
+  assets->fonts[id] = font;
+  assets->flags[id] |= ASSET_FLAG_FONT_LOADED;
+
+  char text[] = "ab";
+  TextRun *a = text_run(id, str8_cstr(text), 32.f, 1.f);
+  assert_non_null(a);
+  assert_int_equal(a->glyph_count, 2);
+  assert_true(f32_eq(a->dim.x, (10.f + 20.f)*2.f + 1.f));
+  assert_true(f32_eq(a->dim.y, 32.f));
+
+  // NOTE(Ryan): Hit regardless of source buffer, miss on differing size
+  text[0] = 'x';
+  assert_ptr_equal(text_run(id, str8_lit("ab"), 32.f, 1.f), a);
+  assert_ptr_not_equal(text_run(id, str8_lit("ab"), 16.f, 1.f), a);
+  assert_int_equal(cache->run_count, 2);
+
+  assets->font_version += 1;
+  text_run(id, str8_lit("ab"), 32.f, 1.f);
+  assert_int_equal(cache->run_count, 1);
+
+  MemArena *assets_arena = assets->arena;
+  *assets = ZERO_STRUCT;
+  assets->arena = assets_arena;
+}
+
+void
+test_ring_spsc(void **state)
+{
+  u8 base[64] = ZERO_STRUCT;
+  RingSPSC r = ZERO_STRUCT;
+  ring_spsc_init(&r, base, sizeof(base));
+
+  // NOTE(Ryan): 24 byte spans, so every few wrap around end
+  u8 span[24] = ZERO_STRUCT;
+  for (u32 i = 0; i < 100; i += 1)
+  {
+    MEMORY_ZERO(span, sizeof(span));
+    span[0] = (u8)i, span[23] = (u8)~i;
+    assert_true(ring_spsc_push(&r, span, sizeof(span)));
+    assert_true(ring_spsc_push(&r, span, sizeof(span)));
+    assert_false(ring_spsc_push(&r, span, sizeof(span)));
+
+    for (u32 j = 0; j < 2; j += 1)
+    {
+      MEMORY_ZERO(span, sizeof(span));
+      assert_true(ring_spsc_pop(&r, span, sizeof(span)));
+      assert_int_equal(span[0], (u8)i);
+      assert_int_equal(span[23], (u8)~i);
+    }
+    assert_false(ring_spsc_pop(&r, span, 1));
+  }
+}
+
+void
+test_magic_ring(void **state)
+{
+  memory_index size = KB(64);
+  u8 *base = mem_magic_ring_allocate(size);
+  assert_non_null(base);
+
+  base[0] = 0xAB;
+  assert_int_equal(base[size], 0xAB);
+  base[size + 1] = 0xCD;
+  assert_int_equal(base[1], 0xCD);
+
+  // NOTE(Ryan): Spans straddling end are still contiguous
+  RingSPSC r = ZERO_STRUCT;
+  ring_spsc_init(&r, base, size);
+  char msg[] = "0123456789";
+  for (u32 i = 0; i < 10000; i += 1)
+  {
+    u8 *dst = ring_spsc_reserve(&r, sizeof(msg));
+    assert_non_null(dst);
+    MEMORY_COPY(dst, msg, sizeof(msg));
+    ring_spsc_commit(&r, sizeof(msg));
+
+    String8 view = ring_spsc_peek(&r);
+    assert_int_equal(view.size, sizeof(msg));
+    assert_true(MEMORY_MATCH(view.content, msg, sizeof(msg)));
+    ring_spsc_consume(&r, view.size);
+  }
+  assert_true(r.write_pos > size);
+
+  mem_magic_ring_release(base, size);
+}
+
+typedef struct TestRingProducer TestRingProducer;
+struct TestRingProducer
+{
+  RingMPMC *ring;
+  u32 first;
+};
+
+#define TEST_RING_PRODUCER_COUNT 4
+#define TEST_RING_PER_PRODUCER 4096
+
 INTERNAL void
-repetition_test(void)
+test_ring_mpmc_produce(void *data)
 {
-  // NOTE(Ryan): Unique for each function to repeat on
-  RepetitionTester tester = ZERO_STRUCT;
+  TestRingProducer *p = (TestRingProducer *)data;
+  for (u32 i = 0; i < TEST_RING_PER_PRODUCER; i += 2)
+  {
+    u32 pair[2] = {p->first + i, p->first + i + 1};
+    while (!ring_mpmc_push(p->ring, pair, 2)) thread_yield();
+  }
+}
 
-  u32 count = 1000;
-  printf("\n--- Repetition Test (mov_all_bytes_asm) ---\n");
-  tester_init_new_wave(&tester, count, linux_estimate_cpu_timer_freq());
-  // this should run for 10 seconds
-  mov_all_bytes_asm_repeat(&tester, count);
+void
+test_ring_mpmc(void **state)
+{
+  u64 seqs[16] = ZERO_STRUCT;
+  u32 elems[16] = ZERO_STRUCT;
+  RingMPMC r = ZERO_STRUCT;
+  ring_mpmc_init(&r, seqs, elems, ARRAY_COUNT(elems), sizeof(u32));
+
+  // NOTE(Ryan): Spans of 3 into 16 slots, so spans wrap
+  u32 span[3] = ZERO_STRUCT;
+  for (u32 i = 0; i < 40; i += 1)
+  {
+    span[0] = i, span[1] = i + 1, span[2] = i + 2;
+    assert_true(ring_mpmc_push(&r, span, 3));
+    MEMORY_ZERO(span, sizeof(span));
+    assert_true(ring_mpmc_pop(&r, span, 3));
+    assert_int_equal(span[0], i);
+    assert_int_equal(span[2], i + 2);
+  }
+  assert_false(ring_mpmc_pop_ptr(&r, span));
+  for (u32 i = 0; i < 16; i += 1) assert_true(ring_mpmc_push_ptr(&r, &i));
+  assert_false(ring_mpmc_push_ptr(&r, span));
+  for (u32 i = 0; i < 16; i += 1) assert_true(ring_mpmc_pop_ptr(&r, span));
+
+  // NOTE(Ryan): Concurrent producers, with each value consumed exactly once
+  TestRingProducer producers[TEST_RING_PRODUCER_COUNT] = ZERO_STRUCT;
+  JobCounter counter = ZERO_STRUCT;
+  for (u32 i = 0; i < TEST_RING_PRODUCER_COUNT; i += 1)
+  {
+    producers[i].ring = &r;
+    producers[i].first = i * TEST_RING_PER_PRODUCER;
+    job_submit(&g_state->jobs, test_ring_mpmc_produce, &producers[i], &counter);
+  }
+
+  u32 total = TEST_RING_PRODUCER_COUNT * TEST_RING_PER_PRODUCER;
+  u8 *seen = (u8 *)calloc(total, 1);
+  for (u32 popped = 0; popped < total; )
+  {
+    u32 v = 0;
+    if (ring_mpmc_pop_ptr(&r, &v))
+    {
+      assert_true(v < total);
+      assert_int_equal(seen[v], 0);
+      seen[v] = 1;
+      popped += 1;
+    }
+    else
+    {
+      // NOTE(Ryan): Not helping with jobs, as a producer run here would spin on a full ring
+      thread_yield();
+    }
+  }
+  job_wait(&g_state->jobs, &counter);
+  free(seen);
+}
+
+INTERNAL void
+test_job_increment(void *data)
+{
+  atomic_u32_fetch_add((u32 *)data, 1, MEMORY_ORDER_RELAXED);
+}
+
+typedef struct TestAtomicNode TestAtomicNode;
+struct TestAtomicNode
+{
+  TestAtomicNode *next;
+  u64 value;
+};
+
+typedef struct TestAtomics TestAtomics;
+struct TestAtomics
+{
+  u64 sum;
+  TestAtomicNode *head;
+  TestAtomicNode nodes[256];
+  u32 node_count;
+};
+
+// NOTE(Ryan): CAS loops, as used for lock-free lists
+INTERNAL void
+test_atomics_job(void *data)
+{
+  TestAtomics *a = (TestAtomics *)data;
+
+  u32 i = atomic_u32_fetch_add(&a->node_count, 1, MEMORY_ORDER_RELAXED);
+  TestAtomicNode *node = &a->nodes[i];
+  node->value = i + 1;
+
+  void * volatile *head = (void * volatile *)&a->head;
+  node->next = (TestAtomicNode *)atomic_ptr_load(head, MEMORY_ORDER_RELAXED);
+  while (!atomic_ptr_cas_weak(head, (void **)&node->next, node, MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED)) {}
+
+  u64 sum = atomic_u64_load(&a->sum, MEMORY_ORDER_RELAXED);
+  while (!atomic_u64_cas_weak(&a->sum, &sum, sum + node->value, MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED))
+  {
+    cpu_pause();
+  }
 }
 
 void
-test_example(void **state)
+test_atomics(void **state)
 {
+  JobSystem *js = &g_state->jobs;
 
+  TestAtomics *a = (TestAtomics *)calloc(1, sizeof(TestAtomics));
+  JobCounter counter = ZERO_STRUCT;
+  for (u32 i = 0; i < ARRAY_COUNT(a->nodes); i += 1) job_submit(js, test_atomics_job, a, &counter);
+  job_wait(js, &counter);
+
+  u64 expected = ARRAY_COUNT(a->nodes) * (ARRAY_COUNT(a->nodes) + 1) / 2;
+  assert_int_equal(a->sum, expected);
+
+  u64 list_sum = 0;
+  TestAtomicNode *head = (TestAtomicNode *)atomic_ptr_load_acquire((void * volatile *)&a->head);
+  for (TestAtomicNode *n = head; n != NULL; n = n->next) list_sum += n->value;
+  assert_int_equal(list_sum, expected);
+
+  assert_int_equal(atomic_u32_exchange(&a->node_count, 0, MEMORY_ORDER_ACQ_REL), ARRAY_COUNT(a->nodes));
+  free(a);
+}
+
+typedef struct TestJobFanOut TestJobFanOut;
+struct TestJobFanOut
+{
+  JobSystem *js;
+  u32 *count;
+};
+
+// NOTE(Ryan): Nested submit and wait from within a job
+INTERNAL void
+test_job_fan_out(void *data)
+{
+  TestJobFanOut *fan_out = (TestJobFanOut *)data;
+  JobCounter counter = ZERO_STRUCT;
+  for (u32 i = 0; i < 64; i += 1) job_submit(fan_out->js, test_job_increment, fan_out->count, &counter);
+  job_wait(fan_out->js, &counter);
+  assert_non_null(thread_context_get());
+}
+
+void
+test_job_system(void **state)
+{
+  JobSystem *js = &g_state->jobs;
+
+  // NOTE(Ryan): More jobs than a deque holds, so overflow runs inline
+  u32 count = 0;
+  JobCounter counter = ZERO_STRUCT;
+  for (u32 i = 0; i < JOB_DEQUE_SIZE * 2; i += 1) job_submit(js, test_job_increment, &count, &counter);
+  job_wait(js, &counter);
+  assert_int_equal(counter.pending, 0);
+  assert_int_equal(count, JOB_DEQUE_SIZE * 2);
+
+  count = 0;
+  TestJobFanOut fan_out = {js, &count};
+  for (u32 i = 0; i < 16; i += 1) job_submit(js, test_job_fan_out, &fan_out, &counter);
+  job_wait(js, &counter);
+  assert_int_equal(count, 16 * 64);
+}
+
+INTERNAL void
+test_parallel_for_even(ParallelChunk *chunk, void *data)
+{
+  assert_non_null(chunk->scratch);
+  for (u32 i = chunk->first; i < chunk->end; i += 1)
+  {
+    if ((i & 1) == 0) *PARALLEL_CHUNK_PUSH_OUTPUT(chunk, u32) = i;
+  }
+}
+
+void
+test_parallel_for(void **state)
+{
+  MemArena *arena = g_state->frame_arena;
+  u32 chunk_sizes[] = {1, 7, 1024, 0};
+  for (u32 c = 0; c < ARRAY_COUNT(chunk_sizes); c += 1)
+  {
+    ParallelFor *pf = parallel_for(&g_state->jobs, arena, 3, 10003, chunk_sizes[c], sizeof(u32), 
+                                   test_parallel_for_even, NULL);
+
+    // NOTE(Ryan): Merged in chunk order, so same sequence regardless of chunking
+    u32 expected = 4;
+    for (u32 i = 0; i < pf->chunk_count; i += 1)
+    {
+      ParallelChunk *chunk = &pf->chunks[i];
+      for (u32 j = 0; j < chunk->output_count; j += 1)
+      {
+        assert_int_equal(*PARALLEL_CHUNK_OUTPUT(chunk, u32, j), expected);
+        expected += 2;
+      }
+    }
+    assert_int_equal(expected, 10004);
+  }
+  mem_arena_reset(arena);
 }
 
 int 
-main(void)
+main(int argc, char *argv[])
 {
   global_debugger_present = linux_was_launched_by_gdb();
 
-  MemArena *arena = mem_arena_allocate(GB(8), MB(64));
-  ThreadContext tctx = thread_context_allocate(GB(8), MB(64));
+  g_mem_arena_failure_hook = arena_failure_warn;
+  MemArena *arena = mem_arena_allocate(MB(64), MB(1));
+  ThreadContext tctx = thread_context_allocate(MB(64), MB(1));
   tctx.is_main_thread = true;
   thread_context_set(&tctx);
   thread_context_set_name("Main Thread");
@@ -74,20 +646,41 @@ main(void)
   State *state = MEM_ARENA_PUSH_STRUCT_ZERO(arena, State);
   g_state = state;
   state->arena = arena;
-  state->frame_arena = mem_arena_allocate(GB(1), MB(64));
-  state->assets.arena = mem_arena_allocate(GB(1), MB(64));
-
-  #define REPETITION 1
-  #if REPETITION
-    repetition_test(); 
-    return 0;
-  #else
+  state->frame_arenas[0] = mem_arena_allocate(MB(64), MB(1));
+  state->frame_arenas[1] = mem_arena_allocate(MB(64), MB(1));
+  state->frame_arena = state->frame_arenas[0];
+  state->prev_frame_arena = state->frame_arenas[1];
+  state->assets.arena = mem_arena_allocate(MB(16), MB(1));
+  state->text_cache.arena = mem_arena_allocate(MB(8), MB(8));
+  job_system_start(&state->jobs, arena, &tctx, MAX(linux_logical_cores(), 4));
+
+  // NOTE(Ryan): Unit tests by default, benchmarks when asked for
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    return benchmarks_run(argc - 2, argv + 2);
+  }
+
 	const struct CMUnitTest tests[] = {
     cmocka_unit_test(test_example),
+    cmocka_unit_test(test_arena_commit),
+    cmocka_unit_test(test_arena_chain),
+    cmocka_unit_test(test_frame_arenas_flip),
+    cmocka_unit_test(test_entity_handles),
+    cmocka_unit_test(test_entity_type_ranges),
+    cmocka_unit_test(test_mem_pool),
+    cmocka_unit_test(test_spatial_grid_query),
+    cmocka_unit_test(test_assets_intern),
+    cmocka_unit_test(test_asset_load_queue),
+    cmocka_unit_test(test_text_run_cache),
+    cmocka_unit_test(test_job_system),
+    cmocka_unit_test(test_parallel_for),
+    cmocka_unit_test(test_ring_spsc),
+    cmocka_unit_test(test_ring_mpmc),
+    cmocka_unit_test(test_magic_ring),
+    cmocka_unit_test(test_atomics),
   };
 
   int cmocka_res = cmocka_run_group_tests(tests, NULL, NULL);
 
   return cmocka_res;
-  #endif
 }
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#include "desktop-text.h"
+
+INTERNAL void
+text_cache_flush(TextCache *cache)
+{
+  mem_arena_reset(cache->arena);
+  cache->slots = MEM_ARENA_PUSH_ARRAY_ZERO(cache->arena, TextRun *, TEXT_CACHE_NUM_SLOTS);
+  cache->run_count = 0;
+}
+
+INTERNAL u64
+text_run_hash(ASSET_ID font, String8 text, f32 size, f32 spacing)
+{
+  u64 hash = str8_hash(text);
+  hash = hash_data(hash, &font, sizeof(font));
+  hash = hash_data(hash, &size, sizeof(size));
+  hash = hash_data(hash, &spacing, sizeof(spacing));
+  return hash;
+}
+
+// NOTE(Ryan): Mirrors DrawTextEx()/MeasureTextEx() layout, so output matches raylib
+INTERNAL void
+text_run_layout(MemArena *arena, TextRun *run, Font font)
+{
+  // NOTE(Ryan): Upper bound, as every codepoint is at least 1 byte
+  run->glyphs = MEM_ARENA_PUSH_ARRAY(arena, TextGlyph, run->text.size);
+
+  f32 scale = run->size / (f32)font.baseSize;
+  f32 padding = (f32)font.glyphPadding;
+  // NOTE(Ryan): raylib default, i.e. SetTextLineSpacing() is never called
+  f32 line_spacing = 15.f;
+
+  f32 x = 0.f, y = 0.f, max_x = 0.f;
+  char *text = (char *)run->text.content;
+  for (u32 i = 0; i < run->text.size;)
+  {
+    s32 codepoint_size = 0;
+    s32 codepoint = GetCodepointNext(text + i, &codepoint_size);
+    s32 index = GetGlyphIndex(font, codepoint);
+    i += (u32)codepoint_size;
+
+    if (codepoint == '\n')
+    {
+      max_x = MAX(max_x, x - run->spacing);
+      x = 0.f;
+      y += line_spacing;
+      continue;
+    }
+
+    GlyphInfo *glyph = &font.glyphs[index];
+    Rectangle rec = font.recs[index];
+    if (codepoint != ' ' && codepoint != '\t')
+    {
+      TextGlyph *g = &run->glyphs[run->glyph_count++];
+      g->src = {rec.x - padding, rec.y - padding, rec.width + 2.f*padding, rec.height + 2.f*padding};
+      g->dst = {x + ((f32)glyph->offsetX - padding)*scale, y + ((f32)glyph->offsetY - padding)*scale,
+                g->src.width*scale, g->src.height*scale};
+    }
+
+    f32 advance = (glyph->advanceX != 0) ? (f32)glyph->advanceX : rec.width;
+    x += advance*scale + run->spacing;
+  }
+  max_x = MAX(max_x, x - run->spacing);
+
+  run->dim.x = MAX(max_x, 0.f);
+  run->dim.y = y + (f32)font.baseSize * scale;
+}
+
+// IMPORTANT(Ryan): Returns NULL if font not resident yet
+INTERNAL TextRun *
+text_run(ASSET_ID font_id, String8 text, f32 size, f32 spacing)
+{
+  Font font = assets_font(font_id);
+  if (!HAS_FLAGS_ANY(g_state->assets.flags[font_id], ASSET_FLAG_FONT_LOADED)) return NULL;
+
+  TextCache *cache = &g_state->text_cache;
+  if (cache->slots == NULL || cache->font_version != g_state->assets.font_version ||
+      mem_arena_pos(cache->arena) > TEXT_CACHE_BUDGET)
+  {
+    text_cache_flush(cache);
+    cache->font_version = g_state->assets.font_version;
+  }
+
+  u64 hash = text_run_hash(font_id, text, size, spacing);
+  TextRun **slot = &cache->slots[hash & (TEXT_CACHE_NUM_SLOTS - 1)];
+  for (TextRun *run = *slot; run != NULL; run = run->hash_chain_next)
+  {
+    if (run->hash == hash && run->font == font_id && f32_eq(run->size, size) && 
+        f32_eq(run->spacing, spacing) && str8_match(run->text, text, 0))
+    {
+      return run;
+    }
+  }
+
+  TextRun *run = MEM_ARENA_PUSH_STRUCT_ZERO(cache->arena, TextRun);
+  run->hash = hash;
+  run->font = font_id;
+  run->size = size;
+  run->spacing = spacing;
+  // NOTE(Ryan): Copy is null-terminated for GetCodepointNext()
+  run->text = str8_copy(cache->arena, text);
+  text_run_layout(cache->arena, run, font);
+
+  __SLL_STACK_PUSH(*slot, run, hash_chain_next);
+  cache->run_count += 1;
+
+  return run;
+}
+
+INTERNAL Vector2
+text_measure(ASSET_ID font_id, String8 text, f32 size, f32 spacing)
+{
+  TextRun *run = text_run(font_id, text, size, spacing);
+  if (run != NULL) return run->dim;
+
+  char *cstr = (char *)str8_copy(g_state->frame_arena, text).content;
+  return MeasureTextEx(GetFontDefault(), cstr, size, spacing);
+}
+
+INTERNAL void
+text_draw(ASSET_ID font_id, String8 text, Vector2 pos, f32 size, f32 spacing, Color colour)
+{
+  TextRun *run = text_run(font_id, text, size, spacing);
+  if (run == NULL)
+  {
+    char *cstr = (char *)str8_copy(g_state->frame_arena, text).content;
+    DrawTextEx(GetFontDefault(), cstr, pos, size, spacing, colour);
+    return;
+  }
+
+  // NOTE(Ryan): Single SDF atlas resolves sharply at any size via sdf_shader
+  Texture texture = g_state->assets.fonts[font_id].texture;
+  BeginShaderMode(g_state->assets.sdf_shader);
+  for (u32 i = 0; i < run->glyph_count; i += 1)
+  {
+    TextGlyph *g = &run->glyphs[i];
+    Rectangle dst = {pos.x + g->dst.x, pos.y + g->dst.y, g->dst.width, g->dst.height};
+    DrawTexturePro(texture, g->src, dst, {0.f, 0.f}, 0.f, colour);
+  }
+  EndShaderMode();
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: zlib-acknowledgement
+#if !defined(DESKTOP_TEXT_H)
+#define DESKTOP_TEXT_H
+
+#include <raylib.h>
+
+#define TEXT_CACHE_NUM_SLOTS 256
+// NOTE(Ryan): Cache is flushed wholesale past this, i.e. no per-run eviction
+#define TEXT_CACHE_BUDGET MB(4)
+
+typedef struct TextGlyph TextGlyph;
+struct TextGlyph
+{
+  Rectangle src;
+  // NOTE(Ryan): Relative to run origin
+  Rectangle dst;
+};
+
+// NOTE(Ryan): Laid out once per (font, text, size, spacing) and reused across frames.
+// Keyed on text content rather than assets_intern() ids, as UI text is formatted per frame 
+// (e.g. counts) and would exhaust ASSETS_MAX_IDS, which are never freed
+typedef struct TextRun TextRun;
+struct TextRun
+{
+  TextRun *hash_chain_next;
+  u64 hash;
+
+  ASSET_ID font;
+  f32 size;
+  f32 spacing;
+  String8 text;
+
+  Vector2 dim;
+  TextGlyph *glyphs;
+  u32 glyph_count;
+};
+
+typedef struct TextCache TextCache;
+struct TextCache
+{
+  MemArena *arena;
+  TextRun **slots;
+  // NOTE(Ryan): Runs reference atlas rects, so invalidated when any font is (re)uploaded
+  u32 font_version;
+  u32 run_count;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #endif
 
 #include "desktop.h"
+#include "desktop-assets-loader.cpp"
 
 #include <dlfcn.h>
 
@@ -78,9 +79,10 @@ int main(int argc, char *argv[])
 #endif
 {
   global_debugger_present = linux_was_launched_by_gdb();
-  MemArena *arena = mem_arena_allocate(GB(8), MB(64));
+  g_mem_arena_failure_hook = arena_failure_warn;
+  MemArena *arena = mem_arena_allocate(MB(64), MB(1));
 
-  ThreadContext tctx = thread_context_allocate(GB(8), MB(64));
+  ThreadContext tctx = thread_context_allocate(MB(64), MB(1));
   tctx.is_main_thread = true;
   thread_context_set(&tctx);
   thread_context_set_name("Main Thread");
@@ -95,9 +97,13 @@ int main(int argc, char *argv[])
 
   State *state = MEM_ARENA_PUSH_STRUCT_ZERO(arena, State);
   state->arena = arena;
-  state->frame_arena = mem_arena_allocate(GB(1), MB(64));
+  state->frame_arenas[0] = mem_arena_allocate(MB(64), MB(1));
+  state->frame_arenas[1] = mem_arena_allocate(MB(64), MB(1));
+  state->frame_arena = state->frame_arenas[0];
+  state->prev_frame_arena = state->frame_arenas[1];
 
-  state->assets.arena = mem_arena_allocate(GB(1), MB(64));
+  state->assets.arena = mem_arena_allocate(MB(16), MB(1));
+  state->text_cache.arena = mem_arena_allocate(MB(8), MB(8));
 
   u32 screen_width = 1920;
   u32 screen_height = 1080;
@@ -107,6 +113,9 @@ int main(int argc, char *argv[])
   InitWindow(screen_width, screen_height, "Game");
   SetTargetFPS(60);
 
+  asset_loader_start(&state->assets.loader);
+  job_system_start(&state->jobs, arena, &tctx, linux_logical_cores());
+
   ReloadCode code = code_reload();
   code.preload(state);
   u64 prev_code_reload_time = GetFileModTime("build/" BINARY_RELOAD_NAME);
@@ -127,9 +136,10 @@ int main(int argc, char *argv[])
     #if ASAN_ENABLED
       if (GetTime() >= 5.0) quit = true;
     #endif
-    // TODO: have a frame (non-cleared) and a world (cleared)
-    mem_arena_reset(state->frame_arena);
+    frame_arenas_flip(state);
   }
+  job_system_stop(&state->jobs);
+  asset_loader_stop(&state->assets.loader);
   CloseWindow();
 
   code.profiler_end_and_print(state);
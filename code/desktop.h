@@ -3,6 +3,8 @@
 
 #include "base/base-inc.h"
 #include "desktop-assets.h"
+#include "desktop-spatial.h"
+#include "desktop-text.h"
 #include <raylib.h>
 #include <raymath.h>
 
@@ -88,27 +90,77 @@ struct BuildingData
   s32 something;
 };
 
-typedef struct Entity Entity;
-struct Entity
+typedef u32 ENTITY_FLAG;
+enum
 {
-  ENTITY_TYPE type;
+  ENTITY_FLAG_WORKBENCH = (1 << 0),
+  ENTITY_FLAG_DESTROYABLE = (1 << 1),
+};
+
+typedef struct EntityCrafting EntityCrafting;
+struct EntityCrafting
+{
+  ENTITY_TYPE entity; // can only queue same entity type
+  u32 queued_amount; // how many iterations of recipe creating
+  f64 timer_start; // 0 means inactive
+};
+
+// NOTE(Ryan): Refer to entities with a Handle {addr, gen} to their slot, obtained with TO_HANDLE().
+// A slot never moves and its generation is bumped when freed, so a stale handle resolves to nil
+typedef struct EntitySlot EntitySlot;
+struct EntitySlot
+{
+  EntitySlot *next_free;
+  u64 gen;
+  u32 dense;
   b32 is_active;
-  Vector2 pos;
-  u32 health;
+};
 
-  // TODO: make mask
-  bool is_item;
-  bool is_workbench;
-  bool is_destroyable;
-  ENTITY_TYPE crafting_entity; // can only queue same entity type
-  u32 queued_crafting_amount; // how many iterations of recipe creating
-  f32 crafting_timer_start; // 0 means inactive
+#define MAX_ENTITIES KB(128)
+#define ENTITY_INDEX_NIL U32_MAX
+// IMPORTANT(Ryan): Hot columns are packed into [0, count) and partitioned by type,
+// i.e. type t occupies [type_first[t], type_first[t+1]). So, iteration only touches live entities.
+// Dense indices change on alloc/free, so don't hold onto them across either
+typedef struct Entities Entities;
+struct Entities
+{
+  u32 count;
+  u32 type_first[ENTITY_TYPE_COUNT + 1];
+  Vector2 pos[MAX_ENTITIES];
+  ENTITY_TYPE type[MAX_ENTITIES];
+  u32 health[MAX_ENTITIES];
+  u32 slot[MAX_ENTITIES];
+
+  // NOTE(Ryan): Cold columns are indexed by slot, so aren't moved when dense ranges shuffle
+  ENTITY_FLAG flags[MAX_ENTITIES];
+  EntityCrafting crafting[MAX_ENTITIES];
+
+  EntitySlot slots[MAX_ENTITIES];
+  // NOTE(Ryan): Slots [0, slot_count) have been handed out at least once
+  u32 slot_count;
+  EntitySlot *free_list;
 
   //ItemID item;
   // TODO:
   // bool render_texture;
   // TEXTURE_ID texture_id;
 };
+
+// NOTE(Ryan): Per-frame inputs for entity passes, gathered beforehand as sprite lookups may upload textures
+typedef struct EntityUpdate EntityUpdate;
+struct EntityUpdate
+{
+  Vector2 hitbox_sizes[ENTITY_TYPE_COUNT];
+  f64 time;
+};
+
+// NOTE(Ryan): Dense indices of entities overlapping the view, grouped by type like Entities
+typedef struct VisibleEntities VisibleEntities;
+struct VisibleEntities
+{
+  u32 *dense;
+  u32 type_first[ENTITY_TYPE_COUNT + 1];
+};
 /*
 Texture *get_texture(TEXTURE_ID id)
 {
@@ -118,19 +170,13 @@ Texture *get_texture(TEXTURE_ID id)
 init() { for (t in textures) warn_if(t == NULL) }
 */
 
-typedef struct Hitbox Hitbox;
-struct Hitbox
-{
-  Hitbox *next;
-  Rectangle r;
-  Entity *e;
-};
-
 typedef enum
 {
   UI_STATE_NIL = 0,
   UI_STATE_INVENTORY,
   UI_STATE_BUILDINGS,
+  UI_STATE_WORKBENCH,
+  UI_STATE_RESEARCH_STATION,
 } UI_STATE;
 
 typedef struct S32Node S32Node;
@@ -148,23 +194,35 @@ INTROSPECT() struct State
   b32 is_initialised;
 
   Assets assets;
+  ASSET_ID entity_sprite_ids[ENTITY_TYPE_COUNT];
+  ASSET_ID ui_font_id;
+  TextCache text_cache;
+
+  // IMPORTANT(Ryan): Started by host, so workers survive reloads.
+  // All jobs must be waited on before code_update() returns, as their code may be unloaded
+  JobSystem jobs;
 
   MemArena *arena;
+  // NOTE(Ryan): Flipped each frame, so frame N-1 allocations are still readable during frame N
+  MemArena *frame_arenas[2];
   MemArena *frame_arena;
+  MemArena *prev_frame_arena;
   u64 frame_counter;
 
-  Entity entities[1024];
-  // TODO: use generation handles
-  Entity *player;
+  Entities entities;
+  Handle player;
 
   bool left_click_consumed;
+  b32 is_profiler_overlay_visible;
 
   UI_STATE ui_state;
   f32 ui_inventory_alpha_t;
   ENTITY_TYPE active_building_type;
+  Handle open_workbench;
 
-  MemArena *hitbox_arena;
-  Hitbox *hitbox_stack;
+  // NOTE(Ryan): Swapped each frame, so last frame's hitboxes stay queryable until next rebuild
+  SpatialGrid hitbox_grid;
+  SpatialGrid prev_hitbox_grid;
 
   InventoryItem inventory_items[ENTITY_TYPE_ITEM_COUNT];
 
@@ -188,6 +246,22 @@ struct ReloadCode
   code_profiler_end_and_print_t profiler_end_and_print;
 };
 
+// NOTE(Ryan): Arenas chain, so this is only hit when OS refuses memory
+INTERNAL void
+arena_failure_warn(MemArena *arena, memory_index size)
+{
+  WARN("Arena push of %lu bytes failed (%u blocks, high water %lu bytes)\n", 
+       size, arena->block_count, arena->high_water);
+}
+
+INTERNAL void
+frame_arenas_flip(State *state)
+{
+  state->prev_frame_arena = state->frame_arena;
+  state->frame_arena = state->frame_arenas[(state->frame_counter + 1) & 1];
+  mem_arena_reset(state->frame_arena);
+}
+
 GLOBAL f32 g_dbg_at_y;
 extern State *g_state; 
 INTERNAL void